@@ -0,0 +1,199 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BINARY_CHANNEL_H
+#define BINARY_CHANNEL_H
+
+#include <prm_utils.h>
+#include <cstring>
+
+namespace openprm
+{
+
+/// Helpers for the packed query interface (PRMProblem::BinaryQuery).
+///
+/// Request, all fields little endian:
+///     uint32 version, uint32 count, uint32 dof,
+///     count times { double start[dof], double goal[dof] }
+/// Response:
+///     uint32 version, uint32 count,
+///     count times { uint32 npoints, double points[npoints*dof] }, npoints is 0 for a failed query
+///
+/// Buffers travel as one base64 string. Built with OPENPRM_BINARY_POINTERS they can
+/// also be raw memory of the caller (address and size passed as text), which avoids
+/// any copy or text conversion of the configurations. That lets anyone able to send
+/// commands read and write any memory of the process, so it is off by default and
+/// only meant for a trusted client in the same process.
+
+const uint32_t BINARY_CHANNEL_VERSION = 1;
+
+inline uint32_t GetUInt32LE(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void PutUInt32LE(uint8_t* p, uint32_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+inline double GetDoubleLE(const uint8_t* p)
+{
+    uint64_t bits = 0;
+    for ( int i = 7; i >= 0; i-- )
+        bits = (bits << 8) | p[i];
+
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void PutDoubleLE(uint8_t* p, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for ( int i = 0; i < 8; i++, bits >>= 8 )
+        p[i] = bits & 0xff;
+}
+
+
+/// Writes a packed response either straight into caller memory or into a
+/// reusable buffer. Past the capacity of the caller memory nothing is written
+/// but the size keeps counting, so the caller learns how much it needs
+class PackedWriter
+{
+public:
+    PackedWriter(std::vector<uint8_t>& buffer, uint8_t* memory, size_t capacity) :
+        buffer_(buffer), memory_(memory), capacity_(capacity), size_(0)
+    {
+        buffer_.clear();
+    }
+
+    /// room for the next bytes, NULL once the caller memory is exhausted
+    uint8_t* reserve(size_t bytes)
+    {
+        size_t offset = size_;
+        size_ += bytes;
+
+        if ( memory_ != NULL )
+            return size_ <= capacity_ ? memory_ + offset : NULL;
+
+        buffer_.resize(size_);
+        return &buffer_[offset];
+    }
+
+    void putUInt32(uint32_t value)
+    {
+        uint8_t* p = reserve(4);
+        if ( p != NULL )
+            PutUInt32LE(p, value);
+    }
+
+    void putConfig(const std::vector<dReal>& config)
+    {
+        uint8_t* p = reserve(8*config.size());
+        if ( p != NULL )
+            for ( size_t i = 0; i < config.size(); i++ )
+                PutDoubleLE(p + 8*i, config[i]);
+    }
+
+    size_t size() const { return size_; }
+    bool overflow() const { return memory_ != NULL && size_ > capacity_; }
+
+protected:
+    std::vector<uint8_t>& buffer_;
+    uint8_t* memory_;
+    size_t capacity_;
+    size_t size_;
+};
+
+
+/// append the base64 encoding of data to out
+inline void Base64Encode(const uint8_t* data, size_t size, std::string& out)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    out.reserve(out.size() + 4*((size + 2)/3));
+    for ( size_t i = 0; i < size; i += 3 )
+    {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if ( i + 1 < size )
+            chunk |= (uint32_t)data[i + 1] << 8;
+        if ( i + 2 < size )
+            chunk |= data[i + 2];
+
+        out.push_back(table[(chunk >> 18) & 0x3f]);
+        out.push_back(table[(chunk >> 12) & 0x3f]);
+        out.push_back(i + 1 < size ? table[(chunk >> 6) & 0x3f] : '=');
+        out.push_back(i + 2 < size ? table[chunk & 0x3f] : '=');
+    }
+}
+
+
+/// decode base64 text into out, returns false on malformed input
+inline bool Base64Decode(const std::string& text, std::vector<uint8_t>& out)
+{
+    out.clear();
+    out.reserve(3*text.size()/4);
+
+    uint32_t chunk = 0;
+    int bits = 0;
+    FOREACHC(it, text)
+    {
+        char c = *it;
+        uint32_t value;
+        if ( c >= 'A' && c <= 'Z' )
+            value = c - 'A';
+        else if ( c >= 'a' && c <= 'z' )
+            value = c - 'a' + 26;
+        else if ( c >= '0' && c <= '9' )
+            value = c - '0' + 52;
+        else if ( c == '+' )
+            value = 62;
+        else if ( c == '/' )
+            value = 63;
+        else if ( c == '=' )
+            break;
+        else
+            return false;
+
+        chunk = (chunk << 6) | value;
+        bits += 6;
+        if ( bits >= 8 )
+        {
+            bits -= 8;
+            out.push_back((chunk >> bits) & 0xff);
+        }
+    }
+
+    return true;
+}
+
+}
+
+#endif // BINARY_CHANNEL_H
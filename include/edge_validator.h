@@ -0,0 +1,187 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef EDGE_VALIDATOR_H
+#define EDGE_VALIDATOR_H
+
+#include <prm_utils.h>
+
+namespace openprm
+{
+
+/// Validates configurations and straight line edges between them for a robot.
+/// When the collision checker can report distances, edges are checked by
+/// conservative advancement: the clearance at a configuration together with
+/// per joint bounds on how far any point of the robot can move gives a stretch
+/// of the edge that is guaranteed free, which is skipped in one step. Otherwise
+/// the edge is checked at a fixed resolution in bisection order.
+///
+/// Checks either see the bare robot, with any grabbed bodies disabled, or only
+/// the grabbed bodies against the environment and the robot links they did not
+/// touch when grabbed. This keeps roadmap validity for the bare robot separate
+/// from the validity of a grasp.
+class EdgeValidator
+{
+public:
+
+    enum CheckTarget
+    {
+        CT_Robot,       ///< the robot without its grabbed bodies
+        CT_Grabbed      ///< only the grabbed bodies, against everything but the links touching them at grab time
+    };
+
+    struct Stats
+    {
+        Stats() : config_checks(0), edge_checks(0), edges_advanced(0), edges_bisected(0),
+            batches(0), batch_jobs(0), state_reuses(0), duplicates(0), state_saves(0) {}
+
+        uint64_t config_checks;
+        uint64_t edge_checks;
+        uint64_t edges_advanced;
+        uint64_t edges_bisected;
+        uint64_t batches;
+        uint64_t batch_jobs;
+        uint64_t state_reuses;      ///< checks that found the robot already in the configuration
+        uint64_t duplicates;        ///< queued configurations answered by an identical neighbor
+        uint64_t state_saves;       ///< robot states saved, each one allocates its link and dof buffers
+    };
+
+    /// saves the robot state once for all checks made while the scope is open, the
+    /// checks then leave the robot where they put it. End or the destructor restores it
+    class QueryScope
+    {
+    public:
+        QueryScope ( EdgeValidator& validator );
+        ~QueryScope ();
+
+        void End ();
+
+    private:
+        EdgeValidator& validator_;
+        boost::shared_ptr<RobotBase::RobotStateSaver> saver_;
+        bool open_;
+    };
+
+    EdgeValidator ( EnvironmentBasePtr penv, RobotBasePtr robot, dReal resolution );
+
+    /// check a single configuration of the active dofs
+    bool CheckConfig ( const std::vector<dReal>& config, CheckTarget target = CT_Robot );
+
+    /// check the straight line edge between two configurations of the active dofs,
+    /// the end points are assumed to have been checked already
+    bool CheckEdge ( const std::vector<dReal>& start, const std::vector<dReal>& goal, CheckTarget target = CT_Robot );
+
+    /// queue a configuration or an edge for CheckQueued, returns the index of its result
+    size_t QueueConfig ( const std::vector<dReal>& config );
+    size_t QueueEdge ( const std::vector<dReal>& start, const std::vector<dReal>& goal );
+
+    /// check everything queued in one pass and clear the queue. Jobs are sorted along
+    /// a space filling curve so consecutive checks see nearly the same robot pose, and
+    /// the robot state, grabbed body state and collision options are set up once for
+    /// the whole batch. results[i] is nonzero when job i is free
+    void CheckQueued ( std::vector<uint8_t>& results, CheckTarget target = CT_Robot );
+
+    /// recompute the joint displacement bounds and the grabbed bodies, call when
+    /// the active dofs or the robot geometry changed
+    void UpdateBounds();
+
+    bool IsGrabbing() const { return grabbed_.size() > 0; }
+
+    const Stats& GetStats() const { return stats_; }
+
+protected:
+
+    EnvironmentBasePtr env_;
+    RobotBasePtr robot_;
+    dReal resolution_;
+
+    /// upper bound on the displacement of any point of the robot per unit
+    /// change of each active dof
+    std::vector<dReal> displacement_bounds_;
+    bool bounds_valid_;
+
+    /// active dofs the bounds were computed for
+    std::vector<int> bounds_dofs_;
+
+    std::vector<KinBodyPtr> grabbed_;
+    std::vector<KinBodyConstPtr> grabbed_excluded_;
+
+    /// robot links each grabbed body may touch, those in contact when it was grabbed.
+    /// grabbed_links_ follows grabbed_, the map keeps the sets by body id across updates
+    std::vector< std::vector<KinBody::LinkConstPtr> > grabbed_links_;
+    std::map< int, std::vector<KinBody::LinkConstPtr> > grab_ignored_;
+
+    /// whether robot links take part in the check of each grabbed body
+    std::vector<bool> grabbed_self_;
+    CheckTarget target_;
+
+    CollisionReportPtr report_;
+    int query_scopes_;
+    std::vector<dReal> config_buffer_;
+    std::vector< std::pair<int,int> > intervals_;
+    Stats stats_;
+
+    /// a queued configuration (goal == npos) or edge, offsets into batch_configs_
+    struct BatchJob
+    {
+        uint64_t key;
+        size_t index;
+        size_t start;
+        size_t goal;
+        size_t dof;
+
+        bool operator<(const BatchJob& other) const { return key < other.key; }
+    };
+
+    std::vector<BatchJob> batch_jobs_;
+    std::vector<dReal> batch_configs_;
+    std::vector<dReal> job_start_, job_goal_;
+    std::vector<dReal> lower_limits_, upper_limits_;
+
+    /// while a batch runs the robot is only moved when the configuration changes
+    bool reuse_state_;
+    std::vector<dReal> last_config_;
+
+    /// the displacement bounds hold for the current active dofs
+    bool boundsMatch ( size_t dof ) const;
+
+    /// check a configuration and return the clearance, negative when unknown
+    bool checkConfigClearance ( const std::vector<dReal>& config, bool use_distance, dReal& clearance );
+
+    /// state saver of a single check, none while a query scope is open
+    RobotBase::RobotStateSaver* saveState ();
+
+    bool checkEdge ( const std::vector<dReal>& start, const std::vector<dReal>& goal, bool use_distance );
+    bool checkEdgeAdvancing ( const std::vector<dReal>& start, const std::vector<dReal>& goal );
+    bool checkEdgeBisection ( const std::vector<dReal>& start, const std::vector<dReal>& goal );
+
+    void interpolate ( const std::vector<dReal>& start, const std::vector<dReal>& goal, dReal t, std::vector<dReal>& config ) const;
+};
+
+typedef boost::shared_ptr<EdgeValidator> EdgeValidatorPtr;
+
+}
+
+#endif // EDGE_VALIDATOR_H
@@ -0,0 +1,171 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef GRASP_LAYER_H
+#define GRASP_LAYER_H
+
+#include <spatial_representation.h>
+
+
+namespace openprm
+{
+
+/// Identifies a set of grabbed bodies and how each one is held: the body
+/// environment id followed by its pose in the grabbing link frame, quantized
+typedef std::vector<int> GraspKey;
+
+
+/// Validity of the roadmap for one grasp, on top of the base validity of the
+/// bare robot. Vertices and edges start out unknown and are only checked when
+/// a search wants to use them.
+class GraspLayer : public EdgeFilter
+{
+public:
+    enum State
+    {
+        GS_Unknown = 0,
+        GS_Free,
+        GS_Blocked
+    };
+
+    GraspLayer() {}
+
+
+    /// build the key for the bodies currently grabbed by robot
+    static GraspKey makeKey(RobotBasePtr robot)
+    {
+        GraspKey key;
+        std::vector<KinBodyPtr> grabbed;
+        robot->GetGrabbed(grabbed);
+
+        FOREACHC(itbody, grabbed)
+        {
+            KinBody::LinkPtr link = robot->IsGrabbing(*itbody);
+            if ( !link )
+                continue;
+
+            Transform grasp = link->GetTransform().inverse()*(*itbody)->GetTransform();
+
+            /// q and -q are the same rotation
+            dReal sign = 1;
+            for ( int i = 0; i < 4; i++ )
+            {
+                if ( RaveFabs(grasp.rot[i]) > 1e-6 )
+                {
+                    sign = grasp.rot[i] < 0 ? -1 : 1;
+                    break;
+                }
+            }
+
+            key.push_back((*itbody)->GetEnvironmentId());
+            for ( int i = 0; i < 4; i++ )
+                key.push_back(quantize(sign*grasp.rot[i]));
+            for ( int i = 0; i < 3; i++ )
+                key.push_back(quantize(grasp.trans[i]));
+        }
+
+        return key;
+    }
+
+
+    State vertexState(vertex_t v) const
+    {
+        return v < vertices_.size() ? (State)vertices_[v] : GS_Unknown;
+    }
+
+    void setVertexState(vertex_t v, State state)
+    {
+        if ( v >= vertices_.size() )
+            vertices_.resize(v + 1, GS_Unknown);
+        vertices_[v] = state;
+    }
+
+    State edgeState(vertex_t u, vertex_t v) const
+    {
+        std::map<std::pair<vertex_t, vertex_t>, uint8_t>::const_iterator it = edges_.find(edgeKey(u, v));
+        return it == edges_.end() ? GS_Unknown : (State)it->second;
+    }
+
+    void setEdgeState(vertex_t u, vertex_t v, State state)
+    {
+        edges_[edgeKey(u, v)] = state;
+    }
+
+    /// only what is known to be blocked is skipped, unknown parts are checked once a path uses them
+    virtual bool blocked(vertex_t u, vertex_t v) const
+    {
+        return vertexState(v) == GS_Blocked || edgeState(u, v) == GS_Blocked;
+    }
+
+    /// follow a renumbering of the roadmap, remap maps old vertex ids to new ones
+    /// or to null_vertex for removed vertices
+    void remap(const std::vector<vertex_t>& remap)
+    {
+        const vertex_t removed = boost::graph_traits<SpatialGraph>::null_vertex();
+
+        std::vector<uint8_t> vertices(remap.size(), GS_Unknown);
+        for ( size_t v = 0; v < vertices_.size() && v < remap.size(); v++ )
+            if ( remap[v] != removed )
+                vertices[remap[v]] = vertices_[v];
+        vertices_.swap(vertices);
+
+        std::map<std::pair<vertex_t, vertex_t>, uint8_t> edges;
+        FOREACHC(it, edges_)
+        {
+            if ( it->first.first < remap.size() && it->first.second < remap.size() &&
+                 remap[it->first.first] != removed && remap[it->first.second] != removed )
+                edges[edgeKey(remap[it->first.first], remap[it->first.second])] = it->second;
+        }
+        edges_.swap(edges);
+    }
+
+    void clear()
+    {
+        vertices_.clear();
+        edges_.clear();
+    }
+
+protected:
+    std::vector<uint8_t> vertices_;
+    std::map<std::pair<vertex_t, vertex_t>, uint8_t> edges_;
+
+    static std::pair<vertex_t, vertex_t> edgeKey(vertex_t u, vertex_t v)
+    {
+        return u < v ? std::make_pair(u, v) : std::make_pair(v, u);
+    }
+
+    /// millimeters for positions, 1e-3 for quaternion components
+    static int quantize(dReal value)
+    {
+        return (int)RaveFloor(value*1000 + dReal(0.5));
+    }
+};
+
+typedef boost::shared_ptr<GraspLayer> GraspLayerPtr;
+
+}
+
+#endif // GRASP_LAYER_H
@@ -66,6 +66,7 @@
 
 #include <boost/assert.hpp>
 #include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
 
 using namespace std;
 
@@ -131,6 +132,105 @@ namespace openprm
 {
 
 /// define some utils
+
+/// position of config along a Z-order (Morton) curve over the box [lower, upper].
+/// Nearby codes mean nearby configurations, so sorting by code gives a spatially
+/// coherent order. Each dimension gets 64/dim bits, at most the first 64 dimensions count
+inline uint64_t MortonCode(const std::vector<dReal>& config, const std::vector<dReal>& lower, const std::vector<dReal>& upper)
+{
+    size_t dim = std::min(config.size(), (size_t)64);
+    if ( dim == 0 )
+        return 0;
+
+    int bits = std::min((int)(64/dim), 21);
+    dReal cells = (dReal)((uint64_t(1) << bits) - 1);
+
+    uint32_t cell[64];
+    for ( size_t i = 0; i < dim; i++ )
+    {
+        dReal range = upper[i] - lower[i];
+        dReal t = range > 0 ? (config[i] - lower[i])/range : 0;
+        cell[i] = (uint32_t)(CLAMP_ON_RANGE<dReal>(t, 0, 1)*cells);
+    }
+
+    uint64_t code = 0;
+    for ( int b = bits - 1; b >= 0; b-- )
+        for ( size_t i = 0; i < dim; i++ )
+            code = (code << 1) | ((cell[i] >> b) & 1);
+
+    return code;
+}
+
+
+/// Pool of configuration buffers so that transient configurations (samples,
+/// query end points) reuse memory instead of going to the heap. Each thread
+/// owns its own pool, see ConfigPool::local(). Only growth of these buffers is
+/// counted, not other allocations on the query path
+class ConfigPool
+{
+public:
+    ConfigPool() : allocations_(0), acquisitions_(0) {}
+
+    /// hand out a buffer of the given dimension
+    void acquire(std::vector<dReal>& config, size_t dim)
+    {
+        acquisitions_++;
+        if ( !free_.empty() )
+        {
+            config.swap(free_.back());
+            free_.pop_back();
+        }
+
+        if ( config.capacity() < dim )
+            allocations_++;
+        config.resize(dim);
+    }
+
+    /// give a buffer back to the pool
+    void release(std::vector<dReal>& config)
+    {
+        free_.push_back(std::vector<dReal>());
+        free_.back().swap(config);
+    }
+
+    uint64_t allocations() const { return allocations_; }
+    uint64_t acquisitions() const { return acquisitions_; }
+
+    /// the pool of the calling thread
+    static ConfigPool& local()
+    {
+        static boost::thread_specific_ptr<ConfigPool> pool;
+        if ( pool.get() == NULL )
+            pool.reset(new ConfigPool());
+        return *pool;
+    }
+
+protected:
+    std::vector< std::vector<dReal> > free_;
+    uint64_t allocations_;
+    uint64_t acquisitions_;
+};
+
+
+/// configuration borrowed from the thread pool for the lifetime of the scope
+struct ScopedConfig
+{
+    ScopedConfig(size_t dim) : pool_(ConfigPool::local())
+    {
+        pool_.acquire(config, dim);
+    }
+
+    ~ScopedConfig()
+    {
+        pool_.release(config);
+    }
+
+    std::vector<dReal> config;
+
+private:
+    ConfigPool& pool_;
+};
+
 }
 
 
@@ -31,6 +31,17 @@
 namespace openprm
 {
 
+/// how new vertices pick the neighbors they try to connect to
+enum ConnectionStrategy
+{
+    CS_Radius,      ///< fixed neighbor_threshold
+    CS_PRMStar,     ///< radius shrinking as (log(n)/n)^(1/d)
+    CS_KPRMStar     ///< k nearest with k growing as log(n)
+};
+
+std::ostream& operator<<(std::ostream& O, ConnectionStrategy strategy);
+std::istream& operator>>(std::istream& I, ConnectionStrategy& strategy);
+
 class PRMParameters : public PlannerBase::PlannerParameters
 {
 public:
@@ -40,6 +51,17 @@ public:
     unsigned int max_nodes_;
     unsigned int max_edges_;
     dReal neighbor_threshold_;
+    dReal edge_resolution_;
+    ConnectionStrategy connection_strategy_;
+    dReal time_limit_;
+    dReal idle_memory_limit_;   ///< MB the roadmap may grow to during idle time
+    dReal rrt_step_;
+    dReal rrt_time_limit_;
+    unsigned int rrt_targets_;
+    unsigned int reorder_threshold_;    ///< new vertices before the roadmap is renumbered, 0 disables
+    unsigned int page_block_size_;      ///< vertices per block of a paged roadmap
+    unsigned int page_cache_blocks_;    ///< blocks of a paged roadmap kept in memory
+    unsigned int max_grasp_layers_;     ///< grasps whose roadmap validity is kept, least recently used go first
 
 protected:
 
@@ -27,6 +27,15 @@
 #define PRMPROBLEM_H
 
 #include <prmparams.h>
+#include <edge_validator.h>
+#include <spatial_representation.h>
+#include <grasp_layer.h>
+#include <rrt_connect.h>
+#include <binary_channel.h>
+#include <trajectory_writer.h>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace openprm
 {
@@ -52,15 +61,94 @@ protected:
     string traj_filename_;
     boost::shared_ptr<ostream> output_traj_stream_;
 
+    boost::shared_ptr<PRMParameters> params_;
+    EdgeValidatorPtr validator_;
+    RRTConnectPtr rrt_;
+    boost::shared_ptr<SpatialStructure> roadmap_;
+    std::vector<vertex_t> path_buffer_;
+
+    /// roadmap validity for the grasps seen so far, the active one is empty when not grabbing
+    std::map<GraspKey, GraspLayerPtr> grasp_layers_;
+    std::list<GraspKey> grasp_order_;   ///< keys of grasp_layers_, most recently used first
+    GraspLayerPtr grasp_layer_;
+
+    /// scratch space for batched validation
+    std::vector<uint8_t> batch_results_;
+    std::vector< std::pair<vertex_t, vertex_t> > layer_pending_;
+
+    /// rrt fallback for end points the roadmap cannot connect
+    std::vector<dReal> rrt_targets_, rrt_branch_;
+    std::vector<vertex_t> rrt_target_vertices_;
+
+    /// saves trajectory files off the environment lock
+    TrajectoryWriterPtr traj_writer_;
+
+    /// packed query channel
+    std::vector<uint8_t> binary_in_, binary_out_;
+    std::string binary_text_;
+
+    /// goal set queries
+    GoalSet goalset_;
+    std::vector<dReal> goal_configs_;
+
+    std::vector<dReal> lower_limits_, upper_limits_;
+    /// active dofs the roadmap was built for
+    std::vector<int> roadmap_dofs_;
+    int roadmap_affine_;
+    dReal prmstar_gamma_;
+    dReal kprmstar_k_;
+
+    /// best path while RunPRM runs and the (seconds, cost) of each improvement
+    std::vector<vertex_t> best_path_;
+    /// end points and rrt branches that only live until the RunPRM returns
+    std::vector<vertex_t> query_vertices_;
+    std::vector< std::pair<dReal, dReal> > cost_history_;
+
+    /// background roadmap growth, runs only while no command is pending
+    boost::shared_ptr<boost::thread> idle_thread_;
+    boost::mutex idle_mutex_;
+    bool idle_stop_;
+    int pending_commands_;
+    uint64_t idle_vertices_;
+
 
 
     bool GrabBody ( ostream& sout, istream& sinput );
     bool ReleaseAll ( ostream& sout, istream& sinput );
-    bool SetActiveTrajectory ( RobotBasePtr robot, TrajectoryBasePtr active_traj, bool execute, const string& strsavetraj, boost::shared_ptr<ostream> pout);
+    bool SetActiveTrajectory ( RobotBasePtr robot, TrajectoryBasePtr active_traj, bool execute, const string& strsavetraj, boost::shared_ptr<ostream> pout, TrajectoryFormat format = TF_Text );
     bool RunPRM ( ostream& sout, istream& sinput );
     bool BuildRoadMap ( ostream& sout, istream& sinput );
     bool RunQuery ( ostream& sout, istream& sinput );
+    bool RunGoalSetQuery ( ostream& sout, istream& sinput );
+    bool BinaryQuery ( ostream& sout, istream& sinput );
     bool TestPrmGraph ( ostream& sout, istream& sinput );
+    bool GetStats ( ostream& sout, istream& sinput );
+    bool IdleGrowth ( ostream& sout, istream& sinput );
+    bool ReorderRoadMap ( ostream& sout, istream& sinput );
+    bool PageRoadMap ( ostream& sout, istream& sinput );
+    bool FlushTrajectoryFiles ( ostream& sout, istream& sinput );
+
+    void StartIdleGrowth ();
+    void StopIdleGrowth ();
+    void IdleGrowthThread ();
+    bool IdleShouldYield ();
+
+    void CreateRoadMap ();
+    void ApplyRoadMapLimits ();
+    bool RoadMapMatchesRobot ();
+    void SampleConfig ( std::vector<dReal>& config );
+    bool CheckEndPoint ( const std::vector<dReal>& config );
+    const std::vector<vertex_t>& Neighbors ( const std::vector<dReal>& config );
+    vertex_t AddToRoadMap ( const std::vector<dReal>& config, bool interruptible = false, bool unbounded = false );
+    void RemoveFromRoadMap ( const std::vector<vertex_t>& vertices );
+    bool ConnectToRoadMap ( const std::vector<dReal>& config, vertex_t& v );
+    bool ConnectWithRRT ( vertex_t v, uint64_t deadline );
+    bool FindPath ( vertex_t start, vertex_t goal, std::vector<vertex_t>& path );
+    int FindPathToAny ( vertex_t start, GoalSet& goalset, std::vector<vertex_t>& path );
+    bool CheckVertexOnLayer ( vertex_t v );
+    bool CheckPathOnLayer ( const std::vector<vertex_t>& path );
+    void UpdateGraspLayer ();
+    void RenumberRoadMap ( bool force );
 
 
     inline std::string getfilename_withseparator(istream& sinput, char separator)
@@ -0,0 +1,160 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef ROADMAP_PAGER_H
+#define ROADMAP_PAGER_H
+
+#include <prm_utils.h>
+
+namespace openprm
+{
+
+/// Disk backed storage for a roadmap too large to keep in memory. Vertices are
+/// split into blocks of consecutive ids, which after a Z-order renumbering are
+/// spatially coherent. Each block holds the configurations and the adjacency of
+/// its vertices and is read on demand into a bounded cache that evicts the least
+/// recently used block. The bounding box of every block stays in memory so
+/// nearest neighbour queries only read blocks that can contain a result.
+///
+/// Blocks are appended as the roadmap grows and a block whose adjacency changed
+/// is rewritten at the end of the file, leaving its old copy unused. The block
+/// file is a scratch file for this process, not a saved roadmap. Its name is
+/// unlinked as soon as it is open, so the space goes back to the system when
+/// the pager is destroyed, even after a crash.
+class RoadMapPager
+{
+public:
+
+    struct Stats
+    {
+        Stats() : loads(0), hits(0), evictions(0), prefetches(0), bytes_read(0) {}
+
+        uint64_t loads;
+        uint64_t hits;
+        uint64_t evictions;
+        uint64_t prefetches;
+        uint64_t bytes_read;
+    };
+
+    /// vertices of one block, adjacency in compressed rows: the neighbours of the
+    /// i-th vertex are targets[offsets[i]] .. targets[offsets[i+1]-1]
+    struct Block
+    {
+        std::vector< std::vector<dReal> > configs;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> targets;
+        std::vector<dReal> lengths;
+
+        size_t size() const { return configs.size(); }
+    };
+
+    RoadMapPager ( int dimension, size_t block_size, size_t cache_blocks );
+    ~RoadMapPager ();
+
+    /// open a new block file and unlink its name. An existing file is only
+    /// replaced with overwrite set
+    bool create ( const std::string& file, bool overwrite = false );
+
+    /// append a full block of the vertices following the last block
+    bool appendBlock ( const Block& block );
+
+    /// replace block b by a new copy with the same vertices, typically with more
+    /// edges. References into a cached copy of b become stale
+    bool rewriteBlock ( size_t b, const Block& block );
+
+    /// block b through the cache. The reference stays valid across the load of
+    /// at least one other block, the cache never evicts the block used last
+    const Block& block ( size_t b );
+
+    /// ask the system to read block b ahead of use without waiting for it
+    void prefetch ( size_t b );
+
+    /// lower bound on the distance from config to any vertex of block b
+    dReal boxDistance ( size_t b, const std::vector<dReal>& config ) const;
+
+    size_t blockOf ( size_t v ) const { return v / block_size_; }
+    bool isCached ( size_t b ) const { return slot_of_[b] >= 0; }
+    size_t numBlocks () const { return index_.size(); }
+    size_t numVertices () const { return vertices_; }
+    size_t blockSize () const { return block_size_; }
+
+    /// bytes held by the cache and the block index
+    size_t memoryUsage () const;
+
+    const Stats& getStats () const { return stats_; }
+
+protected:
+
+    /// where a block lives in the file and what it covers
+    struct BlockEntry
+    {
+        uint64_t offset;
+        uint32_t vertices;
+        uint32_t edges;
+        std::vector<dReal> lower, upper;
+    };
+
+    struct CacheSlot
+    {
+        CacheSlot() : block(-1), used(0) {}
+
+        int block;
+        uint64_t used;
+        Block data;
+    };
+
+    int dimension_;
+    size_t block_size_;
+    size_t cache_blocks_;
+    size_t vertices_;
+
+    std::string file_;
+    uint64_t write_offset_;
+    int fd_;
+
+    std::vector<BlockEntry> index_;
+    std::vector<CacheSlot> slots_;
+    std::vector<int> slot_of_;
+    uint64_t tick_;
+
+    /// staging for a block read or written in one go
+    std::vector<uint8_t> read_buffer_;
+    std::vector<uint8_t> write_buffer_;
+
+    Stats stats_;
+
+    size_t blockBytes ( const BlockEntry& entry ) const;
+    bool load ( size_t b, Block& data );
+
+    /// write block at the end of the file and describe it in entry
+    bool store ( const Block& block, BlockEntry& entry );
+};
+
+typedef boost::shared_ptr<RoadMapPager> RoadMapPagerPtr;
+
+}
+
+#endif // ROADMAP_PAGER_H
@@ -0,0 +1,97 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef RRT_CONNECT_H
+#define RRT_CONNECT_H
+
+#include <edge_validator.h>
+
+#include <boost/function.hpp>
+
+namespace openprm
+{
+
+/// Bounded bidirectional RRT-Connect between one configuration and a set of
+/// target configurations, used to reach the roadmap from end points the
+/// roadmap connection strategy cannot link up
+class RRTConnect
+{
+public:
+    typedef boost::function<void (std::vector<dReal>&)> SampleFn;
+
+    RRTConnect ( EdgeValidatorPtr validator, SampleFn sample, dReal step );
+
+    /// grow a tree from root and one from all targets (dim values each, back to back)
+    /// until they meet or deadline (GetMicroTime) passes. On success branch holds the
+    /// configurations strictly between root and the reached target and the index of
+    /// that target is returned, otherwise -1
+    int Connect ( const std::vector<dReal>& root, const std::vector<dReal>& targets, uint64_t deadline, std::vector<dReal>& branch );
+
+protected:
+
+    enum ExtendResult
+    {
+        ER_Trapped,
+        ER_Advanced,
+        ER_Reached
+    };
+
+    /// nodes back to back in configs, a root has parent -1 and root_index its target (-1 for the root of Connect)
+    struct Tree
+    {
+        std::vector<dReal> configs;
+        std::vector<int> parents;
+        std::vector<int> roots;
+
+        void clear()
+        {
+            configs.clear();
+            parents.clear();
+            roots.clear();
+        }
+
+        int size() const { return parents.size(); }
+    };
+
+    EdgeValidatorPtr validator_;
+    SampleFn sample_;
+    dReal step_;
+    size_t dim_;
+
+    Tree trees_[2];
+    std::vector<dReal> target_, near_, new_, meet_;
+    std::vector<int> chain_;
+
+    ExtendResult extend ( Tree& tree, const std::vector<dReal>& target );
+    int nearest ( const Tree& tree, const std::vector<dReal>& config ) const;
+    void addNode ( Tree& tree, const std::vector<dReal>& config, int parent, int root );
+    void appendBranch ( const Tree& tree, int node, std::vector<dReal>& branch, bool reverse );
+};
+
+typedef boost::shared_ptr<RRTConnect> RRTConnectPtr;
+
+}
+
+#endif // RRT_CONNECT_H
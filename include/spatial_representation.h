@@ -38,6 +38,7 @@
 #include <openrave/planningutils.h>
 
 #include <prm_utils.h>
+#include <roadmap_pager.h>
 
 
 namespace openprm
@@ -60,40 +61,84 @@ typedef boost::graph_traits<SpatialGraph>::vertex_descriptor vertex_t;
 typedef boost::graph_traits<SpatialGraph>::edge_descriptor edge_t;
 
 
+/// Lets a search skip parts of the graph that are known to be invalid
+class EdgeFilter
+{
+public:
+    virtual ~EdgeFilter() {}
+    virtual bool blocked(vertex_t u, vertex_t v) const = 0;
+};
+
+
+
+
+
+/// Targets of a multi goal search. Each entry is a roadmap vertex a goal
+/// configuration connects to, the cost of that connection and the goal it
+/// belongs to, together acting as one virtual super goal
+struct GoalSet
+{
+    std::vector<vertex_t> vertices;
+    std::vector<dReal> costs;
+    std::vector<int> goals;
+
+    /// the goal configurations back to back, used for the search heuristic
+    std::vector<dReal> configs;
+
+    void clear()
+    {
+        vertices.clear();
+        costs.clear();
+        goals.clear();
+        configs.clear();
+    }
+};
+
 
 
 
 class SpatialStructure
 {
 public:
+
+    struct Stats
+    {
+        Stats() : searches(0), buffer_growths(0) {}
+
+        uint64_t searches;
+        uint64_t buffer_growths;
+    };
+
     SpatialStructure() :
-        max_nodes_(100), no_nodes_(0), max_edges_(1000), no_edges_(0), dimension_(7)
+        max_nodes_(100), no_nodes_(0), max_edges_(1000), no_edges_(0), dimension_(7), generation_(0),
+        goalset_(NULL), nodes_at_reorder_(0), paged_vertices_(0), overlay_entries_(0), spill_vertices_(0)
     {
         graph_.clear();
     }
 
     SpatialStructure(int mnodes, int medges, int dim) :
-        max_nodes_(mnodes), no_nodes_(0), max_edges_(medges), no_edges_(0), dimension_(dim)
+        max_nodes_(mnodes), no_nodes_(0), max_edges_(medges), no_edges_(0), dimension_(dim), generation_(0),
+        goalset_(NULL), nodes_at_reorder_(0), paged_vertices_(0), overlay_entries_(0), spill_vertices_(0)
     {
         graph_.clear();
     }
 
 
-    /// add a vertex to the graph
-    vertex_t addVertex(std::vector<dReal> config)
+    /// add a vertex to the graph, unbounded ignores the node limit (for temporary vertices)
+    vertex_t addVertex(const std::vector<dReal>& config, bool unbounded = false)
     {
-        /// check that we dont exceed max nodes
-        if ( no_nodes_ == max_nodes_ )
+        /// check that we dont exceed max nodes, a non positive limit means unbounded
+        if ( !unbounded && max_nodes_ > 0 && no_nodes_ >= max_nodes_ )
         {
             RAVELOG_WARN("SpatialStructure::addVertex - Max nodes reached, ignoring further nodes \n");
-            return;
+            return boost::graph_traits<SpatialGraph>::null_vertex();
         }
 
         /// check that the dimension of the configuration matches graph dimension
-        if ( config.size() != dimension_ )
+        if ( (int)config.size() != dimension_ )
         {
             RAVELOG_WARN("SpatialStructure::addVertex - dimension of configuration does not match graph dimension \n");
-            return;
+            return boost::graph_traits<SpatialGraph>::null_vertex();
         }
 
         vertex_t v = boost::add_vertex(graph_);
@@ -101,29 +146,43 @@ public:
 
         no_nodes_++;
 
-        return v;
+        return paged_vertices_ + v;
     }
 
 
-    /// add an edge to the graph
-    bool addEdge(vertex_t u, vertex_t v, dReal length)
+    /// add an edge to the graph, unbounded ignores the edge limit (for temporary vertices)
+    bool addEdge(vertex_t u, vertex_t v, dReal length, bool unbounded = false)
     {
+        bool paged = u < paged_vertices_ || v < paged_vertices_;
+
         /// check if edge already exists
-        if ( boost::edge(u,v, graph_).second )
+        if ( paged ? hasPagedEdge(u, v) : boost::edge(u - paged_vertices_, v - paged_vertices_, graph_).second )
         {
             RAVELOG_WARN("SpatialStructure::addEdge - edge already exists \n");
             return false;
         }
 
-        /// check that we dont exceed max edges
-        if ( no_edges_ == max_edges_ )
+        /// check that we dont exceed max edges, a non positive limit means unbounded
+        if ( !unbounded && max_edges_ > 0 && no_edges_ >= max_edges_ )
         {
             RAVELOG_WARN("SpatialStructure::addEdge - Max edges reached, ignoring further edges \n");
             return false;
         }
 
-        edge_t e, bool added;
-        boost::tie(e, added) = boost::add_edge(u,v);
+        /// edges touching the paged part are kept in memory beside it
+        if ( paged )
+        {
+            overlay_[u].push_back(std::make_pair(v, length));
+            overlay_[v].push_back(std::make_pair(u, length));
+            overlay_entries_ += 2;
+            no_edges_++;
+
+            return true;
+        }
+
+        edge_t e;
+        bool added;
+        boost::tie(e, added) = boost::add_edge(u - paged_vertices_, v - paged_vertices_, graph_);
 
         if (added)
         {
@@ -136,12 +195,826 @@ public:
         return false;
     }
 
+
+    /// euclidean distance between two configurations
+    static dReal distance(const std::vector<dReal>& a, const std::vector<dReal>& b)
+    {
+        dReal d = 0;
+        for ( size_t i = 0; i < a.size(); i++ )
+            d += (a[i] - b[i])*(a[i] - b[i]);
+        return RaveSqrt(d);
+    }
+
+
+    /// vertices within radius of config, nearest first. The result lives in a
+    /// buffer owned by the structure and is only valid until the next call
+    const std::vector<vertex_t>& nearVertices(const std::vector<dReal>& config, dReal radius)
+    {
+        near_buffer_.clear();
+        near_distances_.clear();
+
+        boost::graph_traits<SpatialGraph>::vertex_iterator vi, vend;
+        for ( boost::tie(vi, vend) = boost::vertices(graph_); vi != vend; ++vi )
+        {
+            dReal d = distance(config, graph_[*vi].config);
+            if ( d <= radius )
+                near_distances_.push_back(std::make_pair(d, paged_vertices_ + *vi));
+        }
+
+        /// only blocks whose bounding box reaches into the radius are read
+        if ( pager_ )
+        {
+            for ( size_t b = 0; b < pager_->numBlocks(); b++ )
+            {
+                if ( pager_->boxDistance(b, config) > radius )
+                    continue;
+
+                const RoadMapPager::Block& block = pager_->block(b);
+                vertex_t first = b*pager_->blockSize();
+                for ( size_t i = 0; i < block.size(); i++ )
+                {
+                    dReal d = distance(config, block.configs[i]);
+                    if ( d <= radius )
+                        near_distances_.push_back(std::make_pair(d, first + i));
+                }
+            }
+        }
+
+        std::sort(near_distances_.begin(), near_distances_.end());
+        FOREACHC(it, near_distances_)
+            near_buffer_.push_back(it->second);
+
+        return near_buffer_;
+    }
+
+
+    /// the k vertices nearest to config, nearest first. Shares the buffer of nearVertices
+    const std::vector<vertex_t>& nearestVertices(const std::vector<dReal>& config, size_t k)
+    {
+        near_buffer_.clear();
+        near_distances_.clear();
+
+        boost::graph_traits<SpatialGraph>::vertex_iterator vi, vend;
+        for ( boost::tie(vi, vend) = boost::vertices(graph_); vi != vend; ++vi )
+            near_distances_.push_back(std::make_pair(distance(config, graph_[*vi].config), paged_vertices_ + *vi));
+
+        /// visit blocks nearest box first until no box can beat the k-th candidate
+        if ( pager_ && k > 0 )
+        {
+            block_order_.clear();
+            for ( size_t b = 0; b < pager_->numBlocks(); b++ )
+                block_order_.push_back(std::make_pair(pager_->boxDistance(b, config), b));
+            std::sort(block_order_.begin(), block_order_.end());
+
+            FOREACHC(it, block_order_)
+            {
+                if ( near_distances_.size() >= k )
+                {
+                    std::nth_element(near_distances_.begin(), near_distances_.begin() + k - 1, near_distances_.end());
+                    near_distances_.resize(k);
+                    if ( it->first > near_distances_[k - 1].first )
+                        break;
+                }
+
+                const RoadMapPager::Block& block = pager_->block(it->second);
+                vertex_t first = it->second*pager_->blockSize();
+                for ( size_t i = 0; i < block.size(); i++ )
+                    near_distances_.push_back(std::make_pair(distance(config, block.configs[i]), first + i));
+            }
+        }
+
+        k = std::min(k, near_distances_.size());
+        std::partial_sort(near_distances_.begin(), near_distances_.begin() + k, near_distances_.end());
+        for ( size_t i = 0; i < k; i++ )
+            near_buffer_.push_back(near_distances_[i].second);
+
+        return near_buffer_;
+    }
+
+
+    /// sum of the edge lengths along a path of vertices
+    dReal pathLength(const std::vector<vertex_t>& path)
+    {
+        dReal length = 0;
+        for ( size_t i = 1; i < path.size(); i++ )
+            length += distance(getConfig(path[i-1]), getConfig(path[i]));
+        return length;
+    }
+
+
+    /// A* search between two vertices, path receives the vertices from start to goal.
+    /// The distance, predecessor and visited buffers persist between searches and are
+    /// invalidated by bumping a generation stamp, so a search never clears them.
+    /// Edges rejected by the optional filter are not traversed
+    bool shortestPath(vertex_t start, vertex_t goal, std::vector<vertex_t>& path, const EdgeFilter* filter = NULL)
+    {
+        path.clear();
+        prepareSearch();
+
+        goal_config_ = getConfig(goal);
+        goalset_ = NULL;
+
+        cost_[start] = 0;
+        pred_[start] = start;
+        stamp_[start] = generation_;
+
+        heap_.clear();
+        heap_.push_back(std::make_pair(-heuristic(start), start));
+
+        while ( !heap_.empty() )
+        {
+            std::pop_heap(heap_.begin(), heap_.end());
+            vertex_t u = heap_.back().second;
+            heap_.pop_back();
+
+            /// stale entry of an already expanded vertex
+            if ( closed_[u] == generation_ )
+                continue;
+            closed_[u] = generation_;
+
+            if ( u == goal )
+            {
+                for ( vertex_t v = goal; v != start; v = pred_[v] )
+                    path.push_back(v);
+                path.push_back(start);
+                std::reverse(path.begin(), path.end());
+                return true;
+            }
+
+            expand(u, filter);
+        }
+
+        return false;
+    }
+
+
+    /// change the node and edge limits, non positive values remove the limit
+    void setLimits(int mnodes, int medges)
+    {
+        max_nodes_ = mnodes;
+        max_edges_ = medges;
+    }
+
+    /// rough estimate of the memory held by the graph and the search buffers, in bytes.
+    /// Of a paged roadmap only the block cache and index count
+    size_t memoryUsage() const
+    {
+        size_t vertex_bytes = sizeof(Vertex) + dimension_*sizeof(dReal)       // property and config
+                              + 3*sizeof(void*);                               // out edge list
+        size_t search_bytes = sizeof(dReal) + sizeof(vertex_t) + 3*sizeof(uint32_t) + sizeof(size_t);
+        size_t edge_bytes = sizeof(Edge) + 2*sizeof(vertex_t) + 2*sizeof(void*) // edge list node
+                            + 2*(sizeof(vertex_t) + sizeof(void*));             // out edge entries
+
+        size_t bytes = boost::num_vertices(graph_)*vertex_bytes + no_nodes_*search_bytes
+                       + boost::num_edges(graph_)*edge_bytes;
+        if ( pager_ )
+            bytes += pager_->memoryUsage() + overlay_entries_*sizeof(std::pair<vertex_t, dReal>)
+                     + overlay_.size()*(sizeof(Adjacency) + 4*sizeof(void*));
+        return bytes;
+    }
+
+    bool isFull() const { return max_nodes_ > 0 && no_nodes_ >= max_nodes_; }
+
+    /// whether the limits leave room for that many more vertices and edges
+    bool hasRoom(size_t vertices, size_t edges) const
+    {
+        return (max_nodes_ <= 0 || no_nodes_ + vertices <= (size_t)max_nodes_) &&
+               (max_edges_ <= 0 || no_edges_ + edges <= (size_t)max_edges_);
+    }
+
+    /// one search towards all goals of the set at once, path receives the vertices
+    /// from start to the roadmap vertex of the cheapest goal. Returns the index of that
+    /// goal, or -1 when none is reachable. Shares the buffers of shortestPath
+    int shortestPathToAny(vertex_t start, const GoalSet& goalset, std::vector<vertex_t>& path, const EdgeFilter* filter = NULL)
+    {
+        path.clear();
+        prepareSearch();
+
+        /// mark the vertices adjacent to the super goal, keeping the cheapest connection
+        for ( size_t i = 0; i < goalset.vertices.size(); i++ )
+        {
+            vertex_t g = goalset.vertices[i];
+            if ( goal_stamp_[g] != generation_ || goalset.costs[i] < goalset.costs[goal_entry_[g]] )
+            {
+                goal_stamp_[g] = generation_;
+                goal_entry_[g] = i;
+            }
+        }
+
+        cost_[start] = 0;
+        pred_[start] = start;
+        stamp_[start] = generation_;
+
+        goalset_ = &goalset;
+
+        heap_.clear();
+        heap_.push_back(std::make_pair(-heuristic(start), start));
+
+        dReal best_cost = std::numeric_limits<dReal>::infinity();
+        vertex_t best_vertex = start;
+        int best_entry = -1;
+
+        while ( !heap_.empty() )
+        {
+            /// the heuristic is admissible, nothing left can beat the best goal
+            if ( -heap_.front().first >= best_cost )
+                break;
+
+            std::pop_heap(heap_.begin(), heap_.end());
+            vertex_t u = heap_.back().second;
+            heap_.pop_back();
+
+            if ( closed_[u] == generation_ )
+                continue;
+            closed_[u] = generation_;
+
+            if ( goal_stamp_[u] == generation_ )
+            {
+                dReal c = cost_[u] + goalset.costs[goal_entry_[u]];
+                if ( c < best_cost )
+                {
+                    best_cost = c;
+                    best_vertex = u;
+                    best_entry = goal_entry_[u];
+                }
+            }
+
+            expand(u, filter);
+        }
+
+        goalset_ = NULL;
+        if ( best_entry < 0 )
+            return -1;
+
+        for ( vertex_t v = best_vertex; v != start; v = pred_[v] )
+            path.push_back(v);
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+
+        return goalset.goals[best_entry];
+    }
+
+
+    /// renumber the vertices along a Z-order curve over [lower, upper] so that vertices
+    /// close in configuration space are close in memory, edges follow in the new order.
+    /// Returns the table mapping old vertex ids to new ones, for updating outside handles
+    const std::vector<vertex_t>& reorder(const std::vector<dReal>& lower, const std::vector<dReal>& upper)
+    {
+        size_t n = boost::num_vertices(graph_);
+
+        /// the block file is written once, a paged roadmap keeps its numbering
+        if ( pager_ )
+        {
+            RAVELOG_WARN("SpatialStructure::reorder - roadmap is paged, keeping the vertex order\n");
+            remap_.resize(paged_vertices_ + n);
+            for ( size_t i = 0; i < remap_.size(); i++ )
+                remap_[i] = i;
+            return remap_;
+        }
+
+        std::vector< std::pair<uint64_t, vertex_t> > order;
+        order.reserve(n);
+        boost::graph_traits<SpatialGraph>::vertex_iterator vi, vend;
+        for ( boost::tie(vi, vend) = boost::vertices(graph_); vi != vend; ++vi )
+            order.push_back(std::make_pair(MortonCode(graph_[*vi].config, lower, upper), *vi));
+        std::sort(order.begin(), order.end());
+
+        remap_.resize(n);
+        for ( size_t i = 0; i < n; i++ )
+            remap_[order[i].second] = i;
+
+        SpatialGraph graph(n);
+        for ( size_t i = 0; i < n; i++ )
+            graph[i].config.swap(graph_[order[i].second].config);
+
+        std::vector< std::pair<std::pair<vertex_t, vertex_t>, dReal> > edges;
+        edges.reserve(boost::num_edges(graph_));
+        boost::graph_traits<SpatialGraph>::edge_iterator ei, eend;
+        for ( boost::tie(ei, eend) = boost::edges(graph_); ei != eend; ++ei )
+        {
+            vertex_t u = remap_[boost::source(*ei, graph_)], v = remap_[boost::target(*ei, graph_)];
+            edges.push_back(std::make_pair(std::make_pair(std::min(u, v), std::max(u, v)), graph_[*ei].length));
+        }
+        std::sort(edges.begin(), edges.end());
+
+        FOREACHC(it, edges)
+        {
+            edge_t e = boost::add_edge(it->first.first, it->first.second, graph).first;
+            graph[e].length = it->second;
+        }
+
+        /// old search stamps are all behind the generation counter and stay harmless
+        graph_.swap(graph);
+        nodes_at_reorder_ = no_nodes_;
+
+        return remap_;
+    }
+
+    /// keep the roadmap in a block file from now on, with a bounded cache of blocks and
+    /// fewer than cache_blocks*block_size vertices in memory, see spill. Vertex ids do not
+    /// change, so reorder first to make the blocks spatially coherent. An empty roadmap
+    /// can be paged too, it then grows into the file from the start
+    bool page(const std::string& file, size_t block_size, size_t cache_blocks, bool overwrite = false)
+    {
+        if ( pager_ )
+        {
+            RAVELOG_WARN("SpatialStructure::page - roadmap is already paged\n");
+            return false;
+        }
+
+        RoadMapPagerPtr pager(new RoadMapPager(dimension_, block_size, cache_blocks));
+        if ( !pager->create(file, overwrite) )
+            return false;
+
+        pager_ = pager;
+        spill_vertices_ = pager_->blockSize()*std::max(cache_blocks, (size_t)2);
+
+        /// every full block goes to the file right away, the rest follows as it fills up
+        if ( !spillBlocks(boost::num_vertices(graph_)/pager_->blockSize()) )
+        {
+            if ( paged_vertices_ == 0 )
+                pager_.reset();
+            return false;
+        }
+
+        return true;
+    }
+
+    /// keep the resident part of a paged roadmap bounded. Once spill_vertices_ vertices
+    /// are in memory the oldest full blocks of them move to the block file, and once as
+    /// many edges of paged vertices are kept beside the file their blocks are rewritten.
+    /// Written blocks are final, so only call while the roadmap holds no temporary
+    /// vertices. Throws when the block file cannot be written
+    void spill()
+    {
+        if ( !pager_ )
+            return;
+
+        size_t n = boost::num_vertices(graph_);
+        if ( n >= spill_vertices_ && !spillBlocks((n - spill_vertices_/2)/pager_->blockSize()) )
+            throw openrave_exception("SpatialStructure::spill - failed to move vertices to the block file");
+
+        if ( overlay_entries_ >= spill_vertices_ && !compactOverlay() )
+            throw openrave_exception("SpatialStructure::spill - failed to rewrite blocks of the block file");
+    }
+
+    /// remove vertices with their edges, typically the temporary end points of a query.
+    /// Later vertices move down to close the gaps, vertices of a paged roadmap cannot be
+    /// removed. Returns the table mapping old vertex ids to new ones, null_vertex for the
+    /// removed ones
+    const std::vector<vertex_t>& removeVertices(const std::vector<vertex_t>& vertices)
+    {
+        size_t n = paged_vertices_ + boost::num_vertices(graph_);
+
+        removed_.clear();
+        FOREACHC(it, vertices)
+        {
+            if ( *it == boost::graph_traits<SpatialGraph>::null_vertex() )
+                continue;
+
+            if ( *it < paged_vertices_ || *it >= n )
+                RAVELOG_WARN("SpatialStructure::removeVertices - vertex is paged or does not exist\n");
+            else
+                removed_.push_back(*it);
+        }
+        std::sort(removed_.begin(), removed_.end());
+        removed_.erase(std::unique(removed_.begin(), removed_.end()), removed_.end());
+
+        /// from the back so the ids still to remove stay valid
+        for ( std::vector<vertex_t>::reverse_iterator it = removed_.rbegin(); it != removed_.rend(); ++it )
+        {
+            vertex_t local = *it - paged_vertices_;
+            no_edges_ -= boost::out_degree(local, graph_);
+            boost::clear_vertex(local, graph_);
+            boost::remove_vertex(local, graph_);
+            no_nodes_--;
+
+            std::map<vertex_t, Adjacency>::iterator itover = overlay_.find(*it);
+            if ( itover != overlay_.end() )
+            {
+                FOREACHC(itadj, itover->second)
+                {
+                    std::map<vertex_t, Adjacency>::iterator itother = overlay_.find(itadj->first);
+                    for ( size_t i = 0; itother != overlay_.end() && i < itother->second.size(); i++ )
+                    {
+                        if ( itother->second[i].first == *it )
+                        {
+                            itother->second.erase(itother->second.begin() + i);
+                            overlay_entries_--;
+                            break;
+                        }
+                    }
+                    no_edges_--;
+                }
+                overlay_entries_ -= itover->second.size();
+                overlay_.erase(itover);
+            }
+        }
+
+        remap_.resize(n);
+        size_t gap = 0;
+        for ( size_t i = 0; i < n; i++ )
+        {
+            if ( gap < removed_.size() && removed_[gap] == i )
+            {
+                remap_[i] = boost::graph_traits<SpatialGraph>::null_vertex();
+                gap++;
+            }
+            else
+                remap_[i] = i - gap;
+        }
+
+        if ( removed_.size() > 0 && overlay_.size() > 0 )
+        {
+            std::map<vertex_t, Adjacency> overlay;
+            FOREACHC(it, overlay_)
+            {
+                Adjacency& adjacency = overlay[remap_[it->first]];
+                FOREACHC(itadj, it->second)
+                    adjacency.push_back(std::make_pair(remap_[itadj->first], itadj->second));
+            }
+            overlay_.swap(overlay);
+        }
+
+        nodes_at_reorder_ = std::min(nodes_at_reorder_, no_nodes_);
+        return remap_;
+    }
+
+    /// vertices added since the last reorder
+    int verticesSinceReorder() const { return no_nodes_ - nodes_at_reorder_; }
+
+    /// configuration of a vertex. For a paged vertex the reference points into the
+    /// block cache and stays valid across at least one more lookup
+    const std::vector<dReal>& getConfig(vertex_t v)
+    {
+        if ( v < paged_vertices_ )
+            return pager_->block(pager_->blockOf(v)).configs[v % pager_->blockSize()];
+        return graph_[v - paged_vertices_].config;
+    }
+
+    size_t degree(vertex_t v)
+    {
+        size_t d = 0;
+        if ( v < paged_vertices_ )
+        {
+            const RoadMapPager::Block& block = pager_->block(pager_->blockOf(v));
+            size_t i = v % pager_->blockSize();
+            d = block.offsets[i + 1] - block.offsets[i];
+        }
+        else
+            d = boost::out_degree(v - paged_vertices_, graph_);
+
+        if ( pager_ )
+        {
+            std::map<vertex_t, Adjacency>::const_iterator it = overlay_.find(v);
+            if ( it != overlay_.end() )
+                d += it->second.size();
+        }
+        return d;
+    }
+
+    int numVertices() const { return no_nodes_; }
+    int numEdges() const { return no_edges_; }
+    int getDimension() const { return dimension_; }
+    const Stats& getStats() const { return stats_; }
+
+    bool isPaged() const { return pager_.get() != NULL; }
+    const RoadMapPager* getPager() const { return pager_.get(); }
+
 protected:
+    typedef std::vector< std::pair<vertex_t, dReal> > Adjacency;
+
     int max_nodes_, no_nodes_;
     int max_edges_, no_edges_;
     int dimension_;
 
     SpatialGraph graph_;
+
+    /// persistent search buffers, an entry is valid only when its stamp matches generation_
+    std::vector<dReal> cost_;
+    std::vector<vertex_t> pred_;
+    std::vector<uint32_t> stamp_;
+    std::vector<uint32_t> closed_;
+    std::vector< std::pair<dReal, vertex_t> > heap_;
+    uint32_t generation_;
+
+    /// target of the running search, a goal set or a single configuration
+    const GoalSet* goalset_;
+    std::vector<dReal> goal_config_;
+
+    std::vector<uint32_t> goal_stamp_;
+    std::vector<size_t> goal_entry_;
+
+    int nodes_at_reorder_;
+    std::vector<vertex_t> remap_;
+    std::vector<vertex_t> removed_;
+
+    std::vector<vertex_t> near_buffer_;
+    std::vector< std::pair<dReal, vertex_t> > near_distances_;
+    std::vector< std::pair<dReal, size_t> > block_order_;
+
+    /// paged storage, vertices below paged_vertices_ live in the block file and
+    /// graph_ holds the ones added later. Edges touching a paged vertex that are
+    /// not in its block are kept in overlay_, overlay_entries_ counts both ends
+    RoadMapPagerPtr pager_;
+    vertex_t paged_vertices_;
+    size_t overlay_entries_;
+    size_t spill_vertices_;
+    std::map<vertex_t, Adjacency> overlay_;
+    Adjacency adjacent_;
+    std::vector<uint32_t> prefetch_stamp_;
+    RoadMapPager::Block spill_block_;
+
+    Stats stats_;
+
+
+    /// distance to the nearest goal configuration, a lower bound on the remaining cost
+    dReal goalHeuristic(const std::vector<dReal>& config, const GoalSet& goalset) const
+    {
+        size_t dim = config.size();
+        dReal best = std::numeric_limits<dReal>::infinity();
+        for ( size_t offset = 0; offset + dim <= goalset.configs.size(); offset += dim )
+        {
+            dReal d = 0;
+            for ( size_t i = 0; i < dim; i++ )
+                d += (config[i] - goalset.configs[offset + i])*(config[i] - goalset.configs[offset + i]);
+            best = std::min(best, d);
+        }
+        return RaveSqrt(best);
+    }
+
+
+    /// lower bound on the remaining cost from v in the running search
+    dReal heuristic(vertex_t v)
+    {
+        if ( goalset_ != NULL )
+            return goalHeuristic(getConfig(v), *goalset_);
+        return distance(getConfig(v), goal_config_);
+    }
+
+
+    /// relax the edges out of u. Of a paged roadmap the neighbours are copied out
+    /// of the block first, as looking at them may load other blocks
+    void expand(vertex_t u, const EdgeFilter* filter)
+    {
+        if ( !pager_ )
+        {
+            boost::graph_traits<SpatialGraph>::out_edge_iterator ei, eend;
+            for ( boost::tie(ei, eend) = boost::out_edges(u, graph_); ei != eend; ++ei )
+                relax(u, boost::target(*ei, graph_), graph_[*ei].length, filter);
+            return;
+        }
+
+        collectAdjacent(u);
+        FOREACHC(it, adjacent_)
+            relax(u, it->first, it->second, filter);
+    }
+
+
+    void relax(vertex_t u, vertex_t v, dReal length, const EdgeFilter* filter)
+    {
+        if ( closed_[v] == generation_ )
+            return;
+
+        if ( filter != NULL && filter->blocked(u, v) )
+            return;
+
+        dReal c = cost_[u] + length;
+        if ( stamp_[v] != generation_ || c < cost_[v] )
+        {
+            stamp_[v] = generation_;
+            cost_[v] = c;
+            pred_[v] = u;
+            heap_.push_back(std::make_pair(-(c + heuristic(v)), v));
+            std::push_heap(heap_.begin(), heap_.end());
+
+            if ( v < paged_vertices_ )
+                prefetchNeighbors(v);
+        }
+    }
+
+
+    /// v just joined the search frontier, its block is cached after the heuristic.
+    /// Start reading the blocks its expansion is going to need
+    void prefetchNeighbors(vertex_t v)
+    {
+        const RoadMapPager::Block& block = pager_->block(pager_->blockOf(v));
+        size_t i = v % pager_->blockSize();
+        for ( uint32_t e = block.offsets[i]; e < block.offsets[i + 1]; e++ )
+        {
+            size_t b = pager_->blockOf(block.targets[e]);
+            if ( block.targets[e] < paged_vertices_ && prefetch_stamp_[b] != generation_ && !pager_->isCached(b) )
+            {
+                prefetch_stamp_[b] = generation_;
+                pager_->prefetch(b);
+            }
+        }
+    }
+
+
+    /// neighbours of u with the edge lengths into adjacent_, for a paged roadmap
+    void collectAdjacent(vertex_t u)
+    {
+        adjacent_.clear();
+        if ( u < paged_vertices_ )
+        {
+            const RoadMapPager::Block& block = pager_->block(pager_->blockOf(u));
+            size_t i = u % pager_->blockSize();
+            for ( uint32_t e = block.offsets[i]; e < block.offsets[i + 1]; e++ )
+                adjacent_.push_back(std::make_pair((vertex_t)block.targets[e], block.lengths[e]));
+        }
+        else
+        {
+            boost::graph_traits<SpatialGraph>::out_edge_iterator ei, eend;
+            for ( boost::tie(ei, eend) = boost::out_edges(u - paged_vertices_, graph_); ei != eend; ++ei )
+                adjacent_.push_back(std::make_pair(paged_vertices_ + boost::target(*ei, graph_), graph_[*ei].length));
+        }
+
+        std::map<vertex_t, Adjacency>::const_iterator it = overlay_.find(u);
+        if ( it != overlay_.end() )
+            adjacent_.insert(adjacent_.end(), it->second.begin(), it->second.end());
+    }
+
+
+    bool hasPagedEdge(vertex_t u, vertex_t v)
+    {
+        collectAdjacent(u);
+        FOREACHC(it, adjacent_)
+            if ( it->first == v )
+                return true;
+        return false;
+    }
+
+
+    /// move the first count blocks worth of in-memory vertices to the block file, with
+    /// their edges and overlay entries. Edges to vertices still in memory are written
+    /// with the block and kept on the other end in overlay_. Stops at the first failed
+    /// write, leaving what was written paged
+    bool spillBlocks(size_t count)
+    {
+        size_t block_size = pager_->blockSize();
+        if ( paged_vertices_ + boost::num_vertices(graph_) > std::numeric_limits<uint32_t>::max() )
+        {
+            RAVELOG_ERROR("SpatialStructure::spillBlocks - too many vertices for the block format\n");
+            return false;
+        }
+
+        size_t written = 0;
+        for ( ; written < count; written++ )
+        {
+            vertex_t first = written*block_size;
+            spill_block_.configs.resize(block_size);
+            spill_block_.offsets.assign(1, 0);
+            spill_block_.targets.clear();
+            spill_block_.lengths.clear();
+
+            for ( vertex_t v = first; v < first + block_size; v++ )
+            {
+                spill_block_.configs[v - first] = graph_[v].config;
+
+                boost::graph_traits<SpatialGraph>::out_edge_iterator ei, eend;
+                for ( boost::tie(ei, eend) = boost::out_edges(v, graph_); ei != eend; ++ei )
+                {
+                    spill_block_.targets.push_back(paged_vertices_ + boost::target(*ei, graph_));
+                    spill_block_.lengths.push_back(graph_[*ei].length);
+                }
+
+                std::map<vertex_t, Adjacency>::const_iterator it = overlay_.find(paged_vertices_ + v);
+                if ( it != overlay_.end() )
+                {
+                    FOREACHC(itadj, it->second)
+                    {
+                        spill_block_.targets.push_back(itadj->first);
+                        spill_block_.lengths.push_back(itadj->second);
+                    }
+                }
+                spill_block_.offsets.push_back(spill_block_.targets.size());
+            }
+
+            if ( !pager_->appendBlock(spill_block_) )
+                break;
+
+            for ( vertex_t v = first; v < first + block_size; v++ )
+            {
+                std::map<vertex_t, Adjacency>::iterator it = overlay_.find(paged_vertices_ + v);
+                if ( it != overlay_.end() )
+                {
+                    overlay_entries_ -= it->second.size();
+                    overlay_.erase(it);
+                }
+            }
+        }
+
+        if ( written == 0 )
+            return written == count;
+
+        /// keep the vertices that stay in memory, their ids do not change
+        size_t moved = written*block_size, n = boost::num_vertices(graph_);
+        SpatialGraph graph(n - moved);
+        for ( size_t i = moved; i < n; i++ )
+            graph[i - moved].config.swap(graph_[i].config);
+
+        boost::graph_traits<SpatialGraph>::edge_iterator ei, eend;
+        for ( boost::tie(ei, eend) = boost::edges(graph_); ei != eend; ++ei )
+        {
+            vertex_t u = boost::source(*ei, graph_), v = boost::target(*ei, graph_);
+            if ( u >= moved && v >= moved )
+            {
+                edge_t e = boost::add_edge(u - moved, v - moved, graph).first;
+                graph[e].length = graph_[*ei].length;
+            }
+            else if ( u >= moved || v >= moved )
+            {
+                vertex_t kept = std::max(u, v), paged = std::min(u, v);
+                overlay_[paged_vertices_ + kept].push_back(std::make_pair(paged_vertices_ + paged, graph_[*ei].length));
+                overlay_entries_++;
+            }
+        }
+
+        graph_.swap(graph);
+        paged_vertices_ += moved;
+        prefetch_stamp_.resize(pager_->numBlocks(), 0);
+
+        RAVELOG_DEBUG(str(boost::format("SpatialStructure::spillBlocks - %d vertices in %d blocks on file, %d in memory\n")
+                          %paged_vertices_%pager_->numBlocks()%boost::num_vertices(graph_)));
+        return written == count;
+    }
+
+
+    /// merge the overlay entries of paged vertices into their blocks
+    bool compactOverlay()
+    {
+        size_t block_size = pager_->blockSize();
+        std::map<vertex_t, Adjacency>::iterator it = overlay_.begin();
+        while ( it != overlay_.end() && it->first < paged_vertices_ )
+        {
+            size_t b = pager_->blockOf(it->first);
+            vertex_t first = b*block_size;
+
+            const RoadMapPager::Block& block = pager_->block(b);
+            spill_block_.configs = block.configs;
+            spill_block_.offsets.assign(1, 0);
+            spill_block_.targets.clear();
+            spill_block_.lengths.clear();
+
+            for ( size_t i = 0; i < block_size; i++ )
+            {
+                spill_block_.targets.insert(spill_block_.targets.end(), block.targets.begin() + block.offsets[i], block.targets.begin() + block.offsets[i + 1]);
+                spill_block_.lengths.insert(spill_block_.lengths.end(), block.lengths.begin() + block.offsets[i], block.lengths.begin() + block.offsets[i + 1]);
+
+                std::map<vertex_t, Adjacency>::const_iterator itover = overlay_.find(first + i);
+                if ( itover != overlay_.end() )
+                {
+                    FOREACHC(itadj, itover->second)
+                    {
+                        spill_block_.targets.push_back(itadj->first);
+                        spill_block_.lengths.push_back(itadj->second);
+                    }
+                }
+                spill_block_.offsets.push_back(spill_block_.targets.size());
+            }
+
+            if ( !pager_->rewriteBlock(b, spill_block_) )
+                return false;
+
+            while ( it != overlay_.end() && it->first < first + block_size )
+            {
+                overlay_entries_ -= it->second.size();
+                overlay_.erase(it++);
+            }
+        }
+
+        return true;
+    }
+
+
+    /// start a new search, only touches the buffers when the graph has grown
+    /// or the generation counter wraps around
+    void prepareSearch()
+    {
+        stats_.searches++;
+
+        size_t n = paged_vertices_ + boost::num_vertices(graph_);
+        if ( stamp_.size() < n )
+        {
+            cost_.resize(n);
+            pred_.resize(n);
+            stamp_.resize(n, 0);
+            closed_.resize(n, 0);
+            goal_stamp_.resize(n, 0);
+            goal_entry_.resize(n);
+            stats_.buffer_growths++;
+        }
+
+        if ( ++generation_ == 0 )
+        {
+            std::fill(stamp_.begin(), stamp_.end(), 0);
+            std::fill(closed_.begin(), closed_.end(), 0);
+            std::fill(goal_stamp_.begin(), goal_stamp_.end(), 0);
+            std::fill(prefetch_stamp_.begin(), prefetch_stamp_.end(), 0);
+            generation_ = 1;
+        }
+    }
 };
 
 
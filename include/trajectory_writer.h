@@ -0,0 +1,103 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef TRAJECTORY_WRITER_H
+#define TRAJECTORY_WRITER_H
+
+#include <prm_utils.h>
+
+#include <deque>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace openprm
+{
+
+enum TrajectoryFormat
+{
+    TF_Text,        ///< the OpenRAVE text format
+    TF_Binary       ///< compact little endian format of WriteBinaryTrajectory
+};
+
+std::ostream& operator<<(std::ostream& O, TrajectoryFormat format);
+std::istream& operator>>(std::istream& I, TrajectoryFormat& format);
+
+
+const uint32_t TRAJECTORY_FORMAT_VERSION = 1;
+
+/// Write a trajectory in the compact binary format, all fields little endian:
+///     uint32 version, uint32 dof, uint32 npoints,
+///     npoints times { double time, double q[dof], double translation[3], double rotation[4] }
+/// with the base rotation as an OpenRAVE quaternion. With base64 set the bytes
+/// are encoded for a text stream. Points go out in fixed size chunks, so memory
+/// use does not depend on the length of the trajectory
+bool WriteBinaryTrajectory(const TrajectoryBase& traj, std::ostream& out, bool base64);
+
+
+/// Saves trajectories to files on a background thread, so writing a long
+/// trajectory never holds up the command that planned it or the environment
+/// lock. A file is written under a temporary name and renamed when complete.
+/// A trajectory handed over must not be changed afterwards
+class TrajectoryWriter
+{
+public:
+    TrajectoryWriter ();
+
+    /// waits for the queued files
+    ~TrajectoryWriter ();
+
+    void Write ( TrajectoryBaseConstPtr traj, const std::string& file, TrajectoryFormat format );
+
+    /// block until every queued file is written
+    void Flush ();
+
+protected:
+
+    struct Job
+    {
+        TrajectoryBaseConstPtr traj;
+        std::string file;
+        TrajectoryFormat format;
+    };
+
+    boost::mutex mutex_;
+    boost::condition_variable changed_;
+    std::deque<Job> jobs_;
+    bool busy_;
+    bool stop_;
+    boost::shared_ptr<boost::thread> thread_;
+
+    void run ();
+    void writeFile ( const Job& job );
+};
+
+typedef boost::shared_ptr<TrajectoryWriter> TrajectoryWriterPtr;
+
+}
+
+#endif // TRAJECTORY_WRITER_H
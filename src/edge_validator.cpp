@@ -0,0 +1,566 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <edge_validator.h>
+
+#include <boost/scoped_ptr.hpp>
+
+using namespace OpenRAVE;
+using namespace openprm;
+
+
+namespace
+{
+
+/// CollisionReport::Reset leaves minDistance at 1e20, checkers that do not
+/// measure a distance leave it there
+bool distanceKnown(dReal distance)
+{
+    return distance >= 0 && distance < dReal(1e19);
+}
+
+
+/// disables the grabbed bodies for the lifetime of the scope so checks see the bare robot
+class GrabbedDisabler
+{
+public:
+    GrabbedDisabler(const std::vector<KinBodyPtr>& bodies, bool active) : bodies_(bodies), active_(active)
+    {
+        if ( active_ )
+            FOREACHC(it, bodies_)
+                (*it)->Enable(false);
+    }
+
+    ~GrabbedDisabler()
+    {
+        if ( active_ )
+            FOREACHC(it, bodies_)
+                (*it)->Enable(true);
+    }
+
+private:
+    const std::vector<KinBodyPtr>& bodies_;
+    bool active_;
+};
+
+
+/// turns on distance queries for the lifetime of the scope when the checker supports them
+class DistanceQueries
+{
+public:
+    DistanceQueries(CollisionCheckerBasePtr checker, bool wanted) : checker_(checker), enabled_(false)
+    {
+        options_ = checker_->GetCollisionOptions();
+        if ( wanted )
+        {
+            enabled_ = checker_->SetCollisionOptions(options_|CO_Distance);
+
+            /// checker cannot report distances
+            if ( !enabled_ )
+                checker_->SetCollisionOptions(options_);
+        }
+    }
+
+    ~DistanceQueries()
+    {
+        if ( enabled_ )
+            checker_->SetCollisionOptions(options_);
+    }
+
+    bool enabled() const { return enabled_; }
+
+private:
+    CollisionCheckerBasePtr checker_;
+    int options_;
+    bool enabled_;
+};
+
+}
+
+
+EdgeValidator::EdgeValidator(EnvironmentBasePtr penv, RobotBasePtr robot, dReal resolution) :
+    env_(penv),
+    robot_(robot),
+    resolution_(resolution),
+    bounds_valid_(false),
+    target_(CT_Robot),
+    report_(new CollisionReport()),
+    query_scopes_(0),
+    reuse_state_(false)
+{
+    UpdateBounds();
+}
+
+
+
+
+EdgeValidator::QueryScope::QueryScope(EdgeValidator &validator) :
+    validator_(validator),
+    saver_(validator.saveState()),
+    open_(true)
+{
+    validator_.query_scopes_++;
+}
+
+
+
+
+EdgeValidator::QueryScope::~QueryScope()
+{
+    End();
+}
+
+
+
+
+void EdgeValidator::QueryScope::End()
+{
+    if ( !open_ )
+        return;
+
+    open_ = false;
+    validator_.query_scopes_--;
+    saver_.reset();
+}
+
+
+
+
+RobotBase::RobotStateSaver* EdgeValidator::saveState()
+{
+    if ( query_scopes_ > 0 )
+        return NULL;
+
+    stats_.state_saves++;
+    return new RobotBase::RobotStateSaver(robot_);
+}
+
+
+
+
+void EdgeValidator::UpdateBounds()
+{
+    displacement_bounds_.clear();
+    bounds_valid_ = false;
+    bounds_dofs_ = robot_->GetActiveDOFIndices();
+
+    robot_->GetActiveDOFLimits(lower_limits_, upper_limits_);
+
+    robot_->GetGrabbed(grabbed_);
+    grabbed_excluded_.clear();
+    FOREACHC(itbody, grabbed_)
+        grabbed_excluded_.push_back(*itbody);
+
+    /// like the grab ignore set of OpenRAVE, a body may touch the link holding it and
+    /// the links in contact when it was grabbed, every other link is checked. Sets are
+    /// only made for newly grabbed bodies, while the robot is still in the grasp pose
+    std::map< int, std::vector<KinBody::LinkConstPtr> > ignored;
+    grabbed_links_.resize(grabbed_.size());
+    grabbed_self_.resize(grabbed_.size());
+    for ( size_t i = 0; i < grabbed_.size(); i++ )
+    {
+        int id = grabbed_[i]->GetEnvironmentId();
+        std::map< int, std::vector<KinBody::LinkConstPtr> >::iterator it = grab_ignored_.find(id);
+        if ( it != grab_ignored_.end() )
+            ignored[id].swap(it->second);
+        else
+        {
+            std::vector<KinBody::LinkConstPtr>& links = ignored[id];
+            KinBody::LinkPtr holder = robot_->IsGrabbing(grabbed_[i]);
+            FOREACHC(itlink, robot_->GetLinks())
+            {
+                if ( *itlink == holder || env_->CheckCollision(KinBody::LinkConstPtr(*itlink), KinBodyConstPtr(grabbed_[i])) )
+                    links.push_back(*itlink);
+            }
+        }
+        grabbed_links_[i] = ignored[id];
+        grabbed_self_[i] = grabbed_links_[i].size() < robot_->GetLinks().size();
+    }
+    grab_ignored_.swap(ignored);
+
+    /// bounds are only derived for joints, base motion is checked at fixed resolution
+    if ( robot_->GetAffineDOF() != 0 )
+    {
+        RAVELOG_DEBUG("EdgeValidator::UpdateBounds - affine dofs active, using fixed resolution checks\n");
+        return;
+    }
+
+    const std::vector<int>& dofindices = robot_->GetActiveDOFIndices();
+    const std::vector<KinBody::LinkPtr>& links = robot_->GetLinks();
+    displacement_bounds_.resize(dofindices.size(), 0);
+
+    std::vector<KinBody::JointPtr> chain;
+    std::vector<dReal> lower, upper;
+
+    for ( size_t i = 0; i < dofindices.size(); i++ )
+    {
+        KinBody::JointPtr joint = robot_->GetJointFromDOFIndex(dofindices[i]);
+
+        /// a prismatic joint moves every point it affects by exactly its displacement
+        if ( joint->IsPrismatic(0) )
+        {
+            displacement_bounds_[i] = 1;
+            continue;
+        }
+
+        /// for a revolute joint the bound is the largest distance from its axis to
+        /// any affected link, summed along the chain so it holds in every configuration
+        dReal bound = 0;
+        FOREACHC(itlink, links)
+        {
+            if ( !robot_->DoesAffect(joint->GetJointIndex(), (*itlink)->GetIndex()) )
+                continue;
+
+            chain.clear();
+            robot_->GetChain(joint->GetHierarchyChildLink()->GetIndex(), (*itlink)->GetIndex(), chain);
+
+            dReal reach = 0;
+            Vector anchor = joint->GetAnchor();
+            FOREACHC(itjoint, chain)
+            {
+                reach += RaveSqrt(((*itjoint)->GetAnchor() - anchor).lengthsqr3());
+                if ( (*itjoint)->IsPrismatic(0) )
+                {
+                    (*itjoint)->GetLimits(lower, upper);
+                    reach += 2*max(RaveFabs(lower.at(0)), RaveFabs(upper.at(0)));
+                }
+                anchor = (*itjoint)->GetAnchor();
+            }
+
+            AABB ab = (*itlink)->ComputeAABB();
+            bound = max(bound, reach + RaveSqrt((ab.pos - anchor).lengthsqr3()) + RaveSqrt(ab.extents.lengthsqr3()));
+
+            /// grabbed bodies move rigidly with the link holding them
+            FOREACHC(itbody, grabbed_)
+            {
+                if ( robot_->IsGrabbing(*itbody) != *itlink )
+                    continue;
+
+                ab = (*itbody)->ComputeAABB();
+                bound = max(bound, reach + RaveSqrt((ab.pos - anchor).lengthsqr3()) + RaveSqrt(ab.extents.lengthsqr3()));
+            }
+        }
+
+        displacement_bounds_[i] = bound;
+    }
+
+    bounds_valid_ = true;
+}
+
+
+
+
+bool EdgeValidator::CheckConfig(const std::vector<dReal> &config, CheckTarget target)
+{
+    boost::scoped_ptr<RobotBase::RobotStateSaver> saver(saveState());
+    GrabbedDisabler disabler(grabbed_, target == CT_Robot);
+    target_ = target;
+
+    dReal clearance;
+    return checkConfigClearance(config, false, clearance);
+}
+
+
+
+
+bool EdgeValidator::CheckEdge(const std::vector<dReal> &start, const std::vector<dReal> &goal, CheckTarget target)
+{
+    boost::scoped_ptr<RobotBase::RobotStateSaver> saver(saveState());
+    GrabbedDisabler disabler(grabbed_, target == CT_Robot);
+    DistanceQueries distance(env_->GetCollisionChecker(), boundsMatch(start.size()));
+    target_ = target;
+
+    return checkEdge(start, goal, distance.enabled());
+}
+
+
+
+
+size_t EdgeValidator::QueueConfig(const std::vector<dReal> &config)
+{
+    BatchJob job;
+    job.index = batch_jobs_.size();
+    job.start = batch_configs_.size();
+    job.goal = std::string::npos;
+    job.dof = config.size();
+
+    batch_configs_.insert(batch_configs_.end(), config.begin(), config.end());
+    batch_jobs_.push_back(job);
+
+    return job.index;
+}
+
+
+
+
+size_t EdgeValidator::QueueEdge(const std::vector<dReal> &start, const std::vector<dReal> &goal)
+{
+    BatchJob job;
+    job.index = batch_jobs_.size();
+    job.start = batch_configs_.size();
+    job.goal = job.start + start.size();
+    job.dof = start.size();
+
+    batch_configs_.insert(batch_configs_.end(), start.begin(), start.end());
+    batch_configs_.insert(batch_configs_.end(), goal.begin(), goal.end());
+    batch_jobs_.push_back(job);
+
+    return job.index;
+}
+
+
+
+
+void EdgeValidator::CheckQueued(std::vector<uint8_t> &results, CheckTarget target)
+{
+    results.resize(batch_jobs_.size());
+    if ( batch_jobs_.size() == 0 )
+        return;
+
+    stats_.batches++;
+    stats_.batch_jobs += batch_jobs_.size();
+
+    /// sort along the curve, edges by their midpoint. Jobs of another dimension than
+    /// the limits, queued before the active dofs changed, keep their order
+    FOREACH(itjob, batch_jobs_)
+    {
+        size_t dof = itjob->dof;
+        itjob->key = 0;
+        if ( dof != lower_limits_.size() )
+            continue;
+
+        job_start_.assign(batch_configs_.begin() + itjob->start, batch_configs_.begin() + itjob->start + dof);
+        if ( itjob->goal != std::string::npos )
+        {
+            job_goal_.assign(batch_configs_.begin() + itjob->goal, batch_configs_.begin() + itjob->goal + dof);
+            interpolate(job_start_, job_goal_, dReal(0.5), job_start_);
+        }
+        itjob->key = MortonCode(job_start_, lower_limits_, upper_limits_);
+    }
+    std::stable_sort(batch_jobs_.begin(), batch_jobs_.end());
+
+    /// conservative advancement only for edges of the dofs the bounds were made for
+    size_t bounds_dof = boundsMatch(displacement_bounds_.size()) ? displacement_bounds_.size() : 0;
+
+    boost::scoped_ptr<RobotBase::RobotStateSaver> saver(saveState());
+    GrabbedDisabler disabler(grabbed_, target == CT_Robot);
+    DistanceQueries distance(env_->GetCollisionChecker(), bounds_dof > 0);
+    target_ = target;
+    reuse_state_ = true;
+    last_config_.clear();
+
+    dReal clearance;
+    const BatchJob* previous = NULL;
+    FOREACHC(itjob, batch_jobs_)
+    {
+        size_t dof = itjob->dof;
+        std::vector<dReal>::const_iterator itstart = batch_configs_.begin() + itjob->start;
+        job_start_.assign(itstart, itstart + dof);
+
+        if ( itjob->goal == std::string::npos )
+        {
+            if ( previous != NULL && previous->dof == dof && std::equal(itstart, itstart + dof, batch_configs_.begin() + previous->start) )
+            {
+                results[itjob->index] = results[previous->index];
+                stats_.duplicates++;
+            }
+            else
+                results[itjob->index] = checkConfigClearance(job_start_, false, clearance);
+
+            previous = &(*itjob);
+        }
+        else
+        {
+            job_goal_.assign(batch_configs_.begin() + itjob->goal, batch_configs_.begin() + itjob->goal + dof);
+            results[itjob->index] = checkEdge(job_start_, job_goal_, distance.enabled() && dof == bounds_dof);
+        }
+    }
+
+    reuse_state_ = false;
+    batch_jobs_.clear();
+    batch_configs_.clear();
+}
+
+
+
+
+bool EdgeValidator::boundsMatch(size_t dof) const
+{
+    /// bounds of other joints would let advancement skip unchecked stretches
+    return bounds_valid_ && displacement_bounds_.size() == dof && robot_->GetAffineDOF() == 0 &&
+           robot_->GetActiveDOFIndices() == bounds_dofs_;
+}
+
+
+
+
+bool EdgeValidator::checkEdge(const std::vector<dReal> &start, const std::vector<dReal> &goal, bool use_distance)
+{
+    stats_.edge_checks++;
+
+    if ( use_distance )
+        return checkEdgeAdvancing(start, goal);
+
+    return checkEdgeBisection(start, goal);
+}
+
+
+
+
+bool EdgeValidator::checkConfigClearance(const std::vector<dReal> &config, bool use_distance, dReal &clearance)
+{
+    clearance = -1;
+    stats_.config_checks++;
+
+    if ( reuse_state_ && last_config_ == config )
+        stats_.state_reuses++;
+    else
+    {
+        robot_->SetActiveDOFValues(config);
+        if ( reuse_state_ )
+            last_config_ = config;
+    }
+
+    if ( target_ == CT_Grabbed )
+    {
+        /// only the links touching a body when it was grabbed may touch it. Body and
+        /// robot links move together, so a distance that may be to a link is halved
+        dReal distance = std::numeric_limits<dReal>::infinity();
+        for ( size_t i = 0; i < grabbed_.size(); i++ )
+        {
+            if ( env_->CheckCollision(KinBodyConstPtr(grabbed_[i]), grabbed_excluded_, grabbed_links_[i], report_) )
+                return false;
+            if ( !distanceKnown(report_->minDistance) )
+                distance = -1;
+            else if ( distance >= 0 )
+                distance = min(distance, grabbed_self_[i] ? dReal(0.5)*report_->minDistance : report_->minDistance);
+        }
+
+        if ( use_distance && distanceKnown(distance) )
+            clearance = distance;
+
+        return true;
+    }
+
+    if ( env_->CheckCollision(KinBodyConstPtr(robot_), report_) )
+        return false;
+
+    dReal env_distance = report_->minDistance;
+    if ( robot_->CheckSelfCollision(report_) )
+        return false;
+
+    /// two links can approach each other at up to twice the bound of a single link,
+    /// without a self distance self collision is unchecked and the step stays fixed
+    if ( use_distance && distanceKnown(env_distance) && distanceKnown(report_->minDistance) )
+        clearance = min(env_distance, dReal(0.5)*report_->minDistance);
+
+    return true;
+}
+
+
+
+
+bool EdgeValidator::checkEdgeAdvancing(const std::vector<dReal> &start, const std::vector<dReal> &goal)
+{
+    stats_.edges_advanced++;
+
+    /// bound on the displacement of any point of the robot per unit of edge parameter
+    dReal motion = 0, max_delta = 0;
+    for ( size_t i = 0; i < start.size(); i++ )
+    {
+        dReal delta = RaveFabs(goal[i] - start[i]);
+        motion += displacement_bounds_[i]*delta;
+        max_delta = max(max_delta, delta);
+    }
+
+    if ( max_delta <= resolution_ || motion <= 0 )
+        return true;
+
+    /// near obstacles never advance less than the fixed resolution would
+    dReal min_step = resolution_/max_delta;
+
+    dReal t = 0, clearance;
+    config_buffer_ = start;
+    while ( true )
+    {
+        if ( !checkConfigClearance(config_buffer_, true, clearance) )
+            return false;
+
+        t += max(clearance/motion, min_step);
+        if ( t >= 1 )
+            return true;
+
+        interpolate(start, goal, t, config_buffer_);
+    }
+}
+
+
+
+
+bool EdgeValidator::checkEdgeBisection(const std::vector<dReal> &start, const std::vector<dReal> &goal)
+{
+    stats_.edges_bisected++;
+
+    dReal max_delta = 0;
+    for ( size_t i = 0; i < start.size(); i++ )
+        max_delta = max(max_delta, RaveFabs(goal[i] - start[i]));
+
+    int steps = (int)ceil(max_delta/resolution_);
+    if ( steps < 2 )
+        return true;
+
+    /// visit the interior points coarse to fine so collisions are found early
+    intervals_.clear();
+    intervals_.push_back(std::make_pair(0, steps));
+
+    dReal clearance;
+    for ( size_t i = 0; i < intervals_.size(); i++ )
+    {
+        int lo = intervals_[i].first, hi = intervals_[i].second;
+        if ( hi - lo < 2 )
+            continue;
+
+        int mid = (lo + hi)/2;
+        interpolate(start, goal, dReal(mid)/steps, config_buffer_);
+        if ( !checkConfigClearance(config_buffer_, false, clearance) )
+            return false;
+
+        intervals_.push_back(std::make_pair(lo, mid));
+        intervals_.push_back(std::make_pair(mid, hi));
+    }
+
+    return true;
+}
+
+
+
+
+void EdgeValidator::interpolate(const std::vector<dReal> &start, const std::vector<dReal> &goal, dReal t, std::vector<dReal> &config) const
+{
+    config.resize(start.size());
+    for ( size_t i = 0; i < start.size(); i++ )
+        config[i] = start[i] + t*(goal[i] - start[i]);
+}
@@ -35,12 +35,34 @@ PRMParameters::PRMParameters() :
     max_nodes_(100),
     max_edges_(10),
     neighbor_threshold_(4.5),
+    edge_resolution_(0.05),
+    connection_strategy_(CS_Radius),
+    time_limit_(5.0),
+    idle_memory_limit_(256),
+    rrt_step_(0.3),
+    rrt_time_limit_(1.0),
+    rrt_targets_(5),
+    reorder_threshold_(1000),
+    page_block_size_(1024),
+    page_cache_blocks_(256),
+    max_grasp_layers_(8),
     processing_(false)
 {
-    _vXMLParameters::push_back("max_tries");
-    _vXMLParameters::push_back("max_nodes");
-    _vXMLParameters::push_back("max_edges");
-    _vXMLParameters::push_back("neighbor_threshold");
+    _vXMLParameters.push_back("max_tries");
+    _vXMLParameters.push_back("max_nodes");
+    _vXMLParameters.push_back("max_edges");
+    _vXMLParameters.push_back("neighbor_threshold");
+    _vXMLParameters.push_back("edge_resolution");
+    _vXMLParameters.push_back("connection_strategy");
+    _vXMLParameters.push_back("time_limit");
+    _vXMLParameters.push_back("idle_memory_limit");
+    _vXMLParameters.push_back("rrt_step");
+    _vXMLParameters.push_back("rrt_time_limit");
+    _vXMLParameters.push_back("rrt_targets");
+    _vXMLParameters.push_back("reorder_threshold");
+    _vXMLParameters.push_back("page_block_size");
+    _vXMLParameters.push_back("page_cache_blocks");
+    _vXMLParameters.push_back("max_grasp_layers");
 }
 
 
@@ -57,6 +79,17 @@ bool PRMParameters::serialize(std::ostream &output_stream) const
     output_stream << "<max_nodes>" << max_nodes_ << "</max_nodes>" << endl;
     output_stream << "<max_edges>" << max_edges_ << "</max_edges>" << endl;
     output_stream << "<neighbor_threshold>" << neighbor_threshold_ << "</neighbor_threshold>" << endl;
+    output_stream << "<edge_resolution>" << edge_resolution_ << "</edge_resolution>" << endl;
+    output_stream << "<connection_strategy>" << connection_strategy_ << "</connection_strategy>" << endl;
+    output_stream << "<time_limit>" << time_limit_ << "</time_limit>" << endl;
+    output_stream << "<idle_memory_limit>" << idle_memory_limit_ << "</idle_memory_limit>" << endl;
+    output_stream << "<rrt_step>" << rrt_step_ << "</rrt_step>" << endl;
+    output_stream << "<rrt_time_limit>" << rrt_time_limit_ << "</rrt_time_limit>" << endl;
+    output_stream << "<rrt_targets>" << rrt_targets_ << "</rrt_targets>" << endl;
+    output_stream << "<reorder_threshold>" << reorder_threshold_ << "</reorder_threshold>" << endl;
+    output_stream << "<page_block_size>" << page_block_size_ << "</page_block_size>" << endl;
+    output_stream << "<page_cache_blocks>" << page_cache_blocks_ << "</page_cache_blocks>" << endl;
+    output_stream << "<max_grasp_layers>" << max_grasp_layers_ << "</max_grasp_layers>" << endl;
 
     return !!output_stream;
 }
@@ -85,7 +118,18 @@ BaseXMLReader::ProcessElement PRMParameters::startElement(const string &name, co
                 name == "max_tries" ||
                 name == "max_nodes" ||
                 name == "max_edges" ||
-                name == "neighbor_threshold"
+                name == "neighbor_threshold" ||
+                name == "edge_resolution" ||
+                name == "connection_strategy" ||
+                name == "time_limit" ||
+                name == "idle_memory_limit" ||
+                name == "rrt_step" ||
+                name == "rrt_time_limit" ||
+                name == "rrt_targets" ||
+                name == "reorder_threshold" ||
+                name == "page_block_size" ||
+                name == "page_cache_blocks" ||
+                name == "max_grasp_layers"
                 );
 
     return processing_ ? PE_Support : PE_Pass;
@@ -106,6 +150,28 @@ bool PRMParameters::endElement(const string &name)
             _ss >> max_edges_;
         else if ( name == "neighbor_threshold" )
             _ss >> neighbor_threshold_;
+        else if ( name == "edge_resolution" )
+            _ss >> edge_resolution_;
+        else if ( name == "connection_strategy" )
+            _ss >> connection_strategy_;
+        else if ( name == "time_limit" )
+            _ss >> time_limit_;
+        else if ( name == "idle_memory_limit" )
+            _ss >> idle_memory_limit_;
+        else if ( name == "rrt_step" )
+            _ss >> rrt_step_;
+        else if ( name == "rrt_time_limit" )
+            _ss >> rrt_time_limit_;
+        else if ( name == "rrt_targets" )
+            _ss >> rrt_targets_;
+        else if ( name == "reorder_threshold" )
+            _ss >> reorder_threshold_;
+        else if ( name == "page_block_size" )
+            _ss >> page_block_size_;
+        else if ( name == "page_cache_blocks" )
+            _ss >> page_cache_blocks_;
+        else if ( name == "max_grasp_layers" )
+            _ss >> max_grasp_layers_;
         else
         {
             RAVELOG_WARN( str(boost::format("unknown tag %s\n")%name ));
@@ -120,3 +186,43 @@ bool PRMParameters::endElement(const string &name)
     return PlannerParameters::endElement(name);
 }
 
+
+
+
+
+std::ostream& openprm::operator<<(std::ostream& O, ConnectionStrategy strategy)
+{
+    switch (strategy)
+    {
+    case CS_PRMStar:
+        return O << "prmstar";
+    case CS_KPRMStar:
+        return O << "kprmstar";
+    default:
+        return O << "radius";
+    }
+}
+
+
+
+
+std::istream& openprm::operator>>(std::istream& I, ConnectionStrategy& strategy)
+{
+    string name;
+    I >> name;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    if ( name == "prmstar" )
+        strategy = CS_PRMStar;
+    else if ( name == "kprmstar" )
+        strategy = CS_KPRMStar;
+    else if ( name == "radius" )
+        strategy = CS_Radius;
+    else
+    {
+        RAVELOG_WARN(str(boost::format("unknown connection strategy %s\n")%name));
+        I.setstate(std::ios::failbit);
+    }
+
+    return I;
+}
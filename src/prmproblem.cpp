@@ -43,6 +43,12 @@ PRMProblem::PRMProblem(EnvironmentBasePtr penv) : ProblemInstance(penv)
     RegisterCommand("RunQuery", boost::bind(&PRMProblem::RunQuery, this, _1, _2),
                     "Run a query on an already built roadmap");
 
+    RegisterCommand("RunGoalSetQuery", boost::bind(&PRMProblem::RunGoalSetQuery, this, _1, _2),
+                    "Run one query towards many goals (repeated goal and/or ikgoal qw qx qy qz tx ty tz) and return the index of the cheapest reached goal");
+
+    RegisterCommand("BinaryQuery", boost::bind(&PRMProblem::BinaryQuery, this, _1, _2),
+                    "Batch of queries as packed little endian doubles: in <base64> (see binary_channel.h)");
+
     RegisterCommand("GrabBody",boost::bind(&PRMProblem::GrabBody,this,_1,_2),
                     "Robot calls ::Grab on a body with its current manipulator");
 
@@ -52,7 +58,26 @@ PRMProblem::PRMProblem(EnvironmentBasePtr penv) : ProblemInstance(penv)
     RegisterCommand("TestPrmGraph",boost::bind(&PRMProblem::TestPrmGraph,this,_1,_2),
                     "Test the prm graph by sampling configs and displaying map (PRMProblem::TestPrmGraph).");
 
+    RegisterCommand("GetStats",boost::bind(&PRMProblem::GetStats,this,_1,_2),
+                    "Report roadmap, collision checking and allocation statistics");
+
+    RegisterCommand("IdleGrowth",boost::bind(&PRMProblem::IdleGrowth,this,_1,_2),
+                    "Enable or disable growing the roadmap in the background between commands");
+
+    RegisterCommand("ReorderRoadMap",boost::bind(&PRMProblem::ReorderRoadMap,this,_1,_2),
+                    "Renumber the roadmap vertices along a space filling curve for cache friendly searches");
+
+    RegisterCommand("FlushTrajectoryFiles",boost::bind(&PRMProblem::FlushTrajectoryFiles,this,_1,_2),
+                    "Wait until every trajectory file queued by savetraj is written");
+
+    RegisterCommand("PageRoadMap",boost::bind(&PRMProblem::PageRoadMap,this,_1,_2),
+                    "Keep the roadmap in a block file with a bounded part of it in memory, also as it grows: file <path> [overwrite] [blocksize n] [cacheblocks n]");
+
     reuseplanner_ = false;
+    idle_stop_ = false;
+    pending_commands_ = 0;
+    idle_vertices_ = 0;
+    roadmap_affine_ = 0;
 }
 
 
@@ -66,6 +91,11 @@ PRMProblem::~PRMProblem()
 
 void PRMProblem::Destroy()
 {
+    StopIdleGrowth();
+    traj_writer_.reset();
+    roadmap_.reset();
+    rrt_.reset();
+    validator_.reset();
     robot_ptr_.reset();
     ProblemInstance::Destroy();
 }
@@ -121,6 +151,13 @@ int PRMProblem::main(const string &args)
 
     RAVELOG_DEBUG(str(boost::format("PRM Planning: using %s planner\n")%planner_name_));
 
+    params_.reset(new PRMParameters());
+    if ( !!robot_ptr_ )
+    {
+        validator_.reset(new EdgeValidator(GetEnv(), robot_ptr_, params_->edge_resolution_));
+        rrt_.reset(new RRTConnect(validator_, boost::bind(&PRMProblem::SampleConfig, this, _1), params_->rrt_step_));
+    }
+
     return 0;
 }
 
@@ -155,8 +192,28 @@ void PRMProblem::SetActiveRobots(const vector<RobotBasePtr> &robots)
 
 bool PRMProblem::SendCommand(ostream &sout, istream &sinput)
 {
-    EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
-    return ProblemInstance::SendCommand(sout,sinput);
+    /// announce the command first so background growth gives up the environment
+    {
+        boost::mutex::scoped_lock idle_lock(idle_mutex_);
+        pending_commands_++;
+    }
+
+    bool result = false;
+    try
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        result = ProblemInstance::SendCommand(sout,sinput);
+    }
+    catch (...)
+    {
+        boost::mutex::scoped_lock idle_lock(idle_mutex_);
+        pending_commands_--;
+        throw;
+    }
+
+    boost::mutex::scoped_lock idle_lock(idle_mutex_);
+    pending_commands_--;
+    return result;
 }
 
 
@@ -211,6 +268,13 @@ bool PRMProblem::GrabBody(ostream &sout, istream &sinput)
 
     robot_ptr_->Grab(ptarget);
 
+    /// the grabbed body extends the links it is attached to
+    if ( !!validator_ )
+        validator_->UpdateBounds();
+
+    /// the roadmap stays valid for the bare robot, the grasp is checked lazily on its own layer
+    UpdateGraspLayer();
+
     return true;
 }
 
@@ -223,6 +287,11 @@ bool PRMProblem::ReleaseAll(ostream &sout, istream &sinput)
     {
         RAVELOG_DEBUGA("Releasing all bodies\n");
         robot_ptr_->ReleaseAllGrabbed();
+
+        if ( !!validator_ )
+            validator_->UpdateBounds();
+
+        grasp_layer_.reset();
     }
     return true;
 }
@@ -231,7 +300,7 @@ bool PRMProblem::ReleaseAll(ostream &sout, istream &sinput)
 
 
 
-bool PRMProblem::SetActiveTrajectory(RobotBasePtr robot, TrajectoryBasePtr active_traj, bool execute, const string &strsavetraj, boost::shared_ptr<ostream> pout)
+bool PRMProblem::SetActiveTrajectory(RobotBasePtr robot, TrajectoryBasePtr active_traj, bool execute, const string &strsavetraj, boost::shared_ptr<ostream> pout, TrajectoryFormat format)
 {
     if	( active_traj->GetPoints().size() == 0 )
     {
@@ -240,36 +309,37 @@ bool PRMProblem::SetActiveTrajectory(RobotBasePtr robot, TrajectoryBasePtr activ
 
     active_traj->CalcTrajTiming(robot, active_traj->GetInterpMethod(), true, true);
 
-    bool execution_done = false;
+    bool set_desired = false;
     if ( execute ) {
         if ( active_traj->GetPoints().size() > 1 )
-        {
             robot->SetActiveMotion(active_traj);
-            execute = true;
-        }
         // have to set anyway since calling script will orEnvWait!
         else if ( !!robot->GetController() )
-        {
-            TrajectoryBasePtr full_traj = RaveCreateTrajectory(GetEnv(), robot->GetDOF());
-            robot->GetFullTrajectoryFromActive(full_traj, active_traj);
-
-            if ( robot->GetController()->SetDesired(full_traj->GetPoints()[0].q) )
-                execution_done = true;
-        }
+            set_desired = true;
     }
 
-    if ( strsavetraj.size() || !!pout ) {
-        TrajectoryBasePtr full_traj = RaveCreateTrajectory(GetEnv(), robot->GetDOF());
+    /// the full trajectory is built once and shared by the controller, the file and the output
+    TrajectoryBasePtr full_traj;
+    if ( set_desired || strsavetraj.size() > 0 || !!pout ) {
+        full_traj = RaveCreateTrajectory(GetEnv(), robot->GetDOF());
         robot->GetFullTrajectoryFromActive(full_traj, active_traj);
+    }
 
-        if ( strsavetraj.size() > 0 ) {
-            ofstream f(strsavetraj.c_str());
-            full_traj->Write(f, Trajectory::TO_IncludeTimestamps|Trajectory::TO_IncludeBaseTransformation);
-        }
+    bool execution_done = false;
+    if ( set_desired && robot->GetController()->SetDesired(full_traj->GetPoints()[0].q) )
+        execution_done = true;
 
-        if ( !!pout ) {
+    if ( strsavetraj.size() > 0 ) {
+        if ( !traj_writer_ )
+            traj_writer_.reset(new TrajectoryWriter());
+        traj_writer_->Write(full_traj, strsavetraj, format);
+    }
+
+    if ( !!pout ) {
+        if ( format == TF_Binary )
+            WriteBinaryTrajectory(*full_traj, *pout, true);
+        else
             full_traj->Write(*pout, Trajectory::TO_IncludeTimestamps|Trajectory::TO_IncludeBaseTransformation|Trajectory::TO_OneLine);
-        }
     }
 
     return execution_done;
@@ -280,8 +350,171 @@ bool PRMProblem::SetActiveTrajectory(RobotBasePtr robot, TrajectoryBasePtr activ
 
 bool PRMProblem::RunPRM(ostream &sout, istream &sinput)
 {
-    RAVELOG_WARN("Not implemented yet\n");
-    return false;
+    if ( !validator_ )
+    {
+        RAVELOG_ERROR("PRMProblem::RunPRM - no robot to plan for\n");
+        return false;
+    }
+
+    int dof = robot_ptr_->GetActiveDOF();
+    ScopedConfig start(dof), goal(dof);
+    robot_ptr_->GetActiveDOFValues(start.config);
+
+    bool has_goal = false, execute = false, output_traj = false, first_solution = false;
+    dReal time_limit = params_->time_limit_;
+    TrajectoryFormat traj_format = TF_Text;
+    string savetraj, cmd;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "start" )
+        {
+            FOREACH(it, start.config)
+                sinput >> *it;
+        }
+        else if ( cmd == "goal" )
+        {
+            FOREACH(it, goal.config)
+                sinput >> *it;
+            has_goal = true;
+        }
+        else if ( cmd == "timelimit" )
+            sinput >> time_limit;
+        else if ( cmd == "firstsolution" )
+            first_solution = true;
+        else if ( cmd == "strategy" )
+            sinput >> params_->connection_strategy_;
+        else if ( cmd == "execute" )
+            sinput >> execute;
+        else if ( cmd == "outputtraj" )
+            output_traj = true;
+        else if ( cmd == "savetraj" )
+            savetraj = getfilename_withseparator(sinput, ';');
+        else if ( cmd == "trajformat" )
+            sinput >> traj_format;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( !has_goal )
+    {
+        RAVELOG_ERROR("PRMProblem::RunPRM - no goal specified\n");
+        return false;
+    }
+
+    /// one robot state saver for every check of the query
+    EdgeValidator::QueryScope scope(*validator_);
+
+    if ( !CheckEndPoint(start.config) || !CheckEndPoint(goal.config) )
+    {
+        RAVELOG_WARN("PRMProblem::RunPRM - start or goal in collision\n");
+        return false;
+    }
+
+    if ( !roadmap_ || roadmap_->getDimension() != dof )
+        CreateRoadMap();
+    else
+        ApplyRoadMapLimits();
+
+    /// the end points join the roadmap only for this query, even when it is full
+    vertex_t vstart = AddToRoadMap(start.config, false, true);
+    vertex_t vgoal = AddToRoadMap(goal.config, false, true);
+    query_vertices_.clear();
+    query_vertices_.push_back(vstart);
+    query_vertices_.push_back(vgoal);
+    if ( vstart == boost::graph_traits<SpatialGraph>::null_vertex() || vgoal == boost::graph_traits<SpatialGraph>::null_vertex() )
+    {
+        RemoveFromRoadMap(query_vertices_);
+        RAVELOG_WARN("PRMProblem::RunPRM - cannot add start and goal to the roadmap\n");
+        return false;
+    }
+
+    uint64_t start_time = GetMicroTime();
+    uint64_t deadline = start_time + (uint64_t)(time_limit*1000000);
+
+    /// end points the roadmap could not link up are reached with a bounded RRT-Connect
+    uint64_t rrt_deadline = std::min(deadline, start_time + (uint64_t)(params_->rrt_time_limit_*1000000));
+    if ( roadmap_->degree(vstart) == 0 && !ConnectWithRRT(vstart, rrt_deadline) )
+        RAVELOG_DEBUG("PRMProblem::RunPRM - rrt could not reach the roadmap from the start\n");
+    if ( roadmap_->degree(vgoal) == 0 && !ConnectWithRRT(vgoal, rrt_deadline) )
+        RAVELOG_DEBUG("PRMProblem::RunPRM - rrt could not reach the roadmap from the goal\n");
+
+    /// anytime loop: keep growing the roadmap until the deadline, the shrinking
+    /// connection sets of PRM* make the best path converge towards the optimum
+    cost_history_.clear();
+    best_path_.clear();
+    dReal best_cost = std::numeric_limits<dReal>::infinity();
+    int searched_edges = -1;
+
+    ScopedConfig sample(dof);
+    while ( true )
+    {
+        /// only search again when new edges may have opened a shorter path
+        if ( roadmap_->numEdges() != searched_edges )
+        {
+            searched_edges = roadmap_->numEdges();
+            if ( FindPath(vstart, vgoal, path_buffer_) )
+            {
+                dReal cost = roadmap_->pathLength(path_buffer_);
+                if ( cost < best_cost )
+                {
+                    best_cost = cost;
+                    best_path_ = path_buffer_;
+                    cost_history_.push_back(std::make_pair(dReal(1e-6)*(GetMicroTime() - start_time), cost));
+                    RAVELOG_DEBUG(str(boost::format("PRMProblem::RunPRM - path cost %f after %fs\n")%cost%cost_history_.back().first));
+
+                    if ( first_solution )
+                        break;
+                }
+            }
+        }
+
+        if ( GetMicroTime() >= deadline || roadmap_->isFull() )
+            break;
+
+        SampleConfig(sample.config);
+        if ( validator_->CheckConfig(sample.config) )
+            AddToRoadMap(sample.config);
+    }
+
+    if ( best_path_.empty() )
+    {
+        RemoveFromRoadMap(query_vertices_);
+        roadmap_->spill();
+        RAVELOG_WARN("PRMProblem::RunPRM - no path found within the time limit\n");
+        return false;
+    }
+
+    scope.End();
+
+    TrajectoryBasePtr traj = RaveCreateTrajectory(GetEnv(), dof);
+    FOREACHC(it, best_path_)
+        traj->AddPoint(Trajectory::TPOINT(roadmap_->getConfig(*it), 0));
+
+    RemoveFromRoadMap(query_vertices_);
+    roadmap_->spill();
+
+    boost::shared_ptr<ostream> pout;
+    if ( output_traj )
+        pout.reset(&sout, null_deleter());
+
+    SetActiveTrajectory(robot_ptr_, traj, execute, savetraj, pout, traj_format);
+
+    return true;
 }
 
 
@@ -289,8 +522,75 @@ bool PRMProblem::RunPRM(ostream &sout, istream &sinput)
 
 bool PRMProblem::BuildRoadMap(ostream &sout, istream &sinput)
 {
-    RAVELOG_WARN("Not implemented yet\n");
-    return false;
+    string cmd, pagefile;
+    bool overwrite = false;
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "nodes" )
+            sinput >> params_->max_nodes_;
+        else if ( cmd == "edges" )
+            sinput >> params_->max_edges_;
+        else if ( cmd == "threshold" )
+            sinput >> params_->neighbor_threshold_;
+        else if ( cmd == "strategy" )
+            sinput >> params_->connection_strategy_;
+        else if ( cmd == "pagefile" )
+            sinput >> pagefile;
+        else if ( cmd == "overwrite" )
+            overwrite = true;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( !validator_ )
+    {
+        RAVELOG_ERROR("PRMProblem::BuildRoadMap - no robot to plan for\n");
+        return false;
+    }
+
+    CreateRoadMap();
+
+    /// with a block file the roadmap can grow past memory, full blocks are written as it grows
+    if ( !pagefile.empty() && !roadmap_->page(pagefile, params_->page_block_size_, params_->page_cache_blocks_, overwrite) )
+        return false;
+
+    /// nodes 0 leaves the size open, the roadmap then grows for time_limit
+    ScopedConfig sample(robot_ptr_->GetActiveDOF());
+    unsigned int tries = 0, max_samples = params_->max_nodes_*params_->max_tries_;
+    uint64_t deadline = GetMicroTime() + (uint64_t)(params_->time_limit_*1000000);
+    while ( params_->max_nodes_ > 0 ? roadmap_->numVertices() < (int)params_->max_nodes_ && tries++ < max_samples
+                                    : GetMicroTime() < deadline )
+    {
+        SampleConfig(sample.config);
+
+        if ( !validator_->CheckConfig(sample.config) )
+            continue;
+
+        AddToRoadMap(sample.config);
+        roadmap_->spill();
+    }
+
+    /// the roadmap is complete, lay it out for the queries to come
+    RenumberRoadMap(true);
+
+    RAVELOG_INFO(str(boost::format("PRMProblem::BuildRoadMap - %d nodes, %d edges\n")%roadmap_->numVertices()%roadmap_->numEdges()));
+    sout << roadmap_->numVertices() << " " << roadmap_->numEdges();
+
+    return true;
 }
 
 
@@ -299,15 +599,1087 @@ bool PRMProblem::BuildRoadMap(ostream &sout, istream &sinput)
 
 bool PRMProblem::RunQuery(ostream &sout, istream &sinput)
 {
-    RAVELOG_WARN("Not implemented yet\n");
-    return false;
+    if ( !roadmap_ || roadmap_->numVertices() == 0 )
+    {
+        RAVELOG_ERROR("PRMProblem::RunQuery - no roadmap, call BuildRoadMap first\n");
+        return false;
+    }
+
+    int dof = robot_ptr_->GetActiveDOF();
+    if ( dof != roadmap_->getDimension() )
+    {
+        RAVELOG_ERROR(str(boost::format("PRMProblem::RunQuery - %d active dofs but the roadmap has %d\n")%dof%roadmap_->getDimension()));
+        return false;
+    }
+
+    ScopedConfig start(dof), goal(dof);
+    robot_ptr_->GetActiveDOFValues(start.config);
+
+    bool has_goal = false, execute = false, output_traj = false;
+    TrajectoryFormat traj_format = TF_Text;
+    string savetraj, cmd;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "start" )
+        {
+            FOREACH(it, start.config)
+                sinput >> *it;
+        }
+        else if ( cmd == "goal" )
+        {
+            FOREACH(it, goal.config)
+                sinput >> *it;
+            has_goal = true;
+        }
+        else if ( cmd == "execute" )
+            sinput >> execute;
+        else if ( cmd == "outputtraj" )
+            output_traj = true;
+        else if ( cmd == "savetraj" )
+            savetraj = getfilename_withseparator(sinput, ';');
+        else if ( cmd == "trajformat" )
+            sinput >> traj_format;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( !has_goal )
+    {
+        RAVELOG_ERROR("PRMProblem::RunQuery - no goal specified\n");
+        return false;
+    }
+
+    /// one robot state saver for every check of the query
+    EdgeValidator::QueryScope scope(*validator_);
+
+    /// edge checks take the end points as already checked
+    if ( !CheckEndPoint(start.config) || !CheckEndPoint(goal.config) )
+    {
+        RAVELOG_WARN("PRMProblem::RunQuery - start or goal in collision\n");
+        return false;
+    }
+
+    vertex_t vstart, vgoal;
+    if ( !ConnectToRoadMap(start.config, vstart) || !ConnectToRoadMap(goal.config, vgoal) )
+    {
+        RAVELOG_WARN("PRMProblem::RunQuery - failed to connect query to the roadmap\n");
+        return false;
+    }
+
+    if ( !FindPath(vstart, vgoal, path_buffer_) )
+    {
+        RAVELOG_WARN("PRMProblem::RunQuery - start and goal are not connected in the roadmap\n");
+        return false;
+    }
+
+    scope.End();
+
+    TrajectoryBasePtr traj = RaveCreateTrajectory(GetEnv(), dof);
+    traj->AddPoint(Trajectory::TPOINT(start.config, 0));
+    FOREACHC(it, path_buffer_)
+        traj->AddPoint(Trajectory::TPOINT(roadmap_->getConfig(*it), 0));
+    traj->AddPoint(Trajectory::TPOINT(goal.config, 0));
+
+    boost::shared_ptr<ostream> pout;
+    if ( output_traj )
+        pout.reset(&sout, null_deleter());
+
+    SetActiveTrajectory(robot_ptr_, traj, execute, savetraj, pout, traj_format);
+
+    return true;
 }
 
 
 
 
-bool PRMProblem::TestPrmGraph(ostream &sout, istream &sinput)
+bool PRMProblem::RunGoalSetQuery(ostream &sout, istream &sinput)
 {
-    RAVELOG_WARN("Not implemented yet\n");
-    return false;
+    if ( !roadmap_ || roadmap_->numVertices() == 0 )
+    {
+        RAVELOG_ERROR("PRMProblem::RunGoalSetQuery - no roadmap, call BuildRoadMap first\n");
+        return false;
+    }
+
+    int dof = robot_ptr_->GetActiveDOF();
+    if ( dof != roadmap_->getDimension() )
+    {
+        RAVELOG_ERROR(str(boost::format("PRMProblem::RunGoalSetQuery - %d active dofs but the roadmap has %d\n")%dof%roadmap_->getDimension()));
+        return false;
+    }
+
+    ScopedConfig start(dof), goal(dof);
+    robot_ptr_->GetActiveDOFValues(start.config);
+    goal_configs_.clear();
+
+    bool execute = false, output_traj = false;
+    TrajectoryFormat traj_format = TF_Text;
+    string savetraj, cmd;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "start" )
+        {
+            FOREACH(it, start.config)
+                sinput >> *it;
+        }
+        else if ( cmd == "goal" )
+        {
+            FOREACH(it, goal.config)
+                sinput >> *it;
+            goal_configs_.insert(goal_configs_.end(), goal.config.begin(), goal.config.end());
+        }
+        else if ( cmd == "ikgoal" )
+        {
+            /// all collision free ik solutions of the active manipulator for the pose
+            Transform pose;
+            sinput >> pose.rot.x >> pose.rot.y >> pose.rot.z >> pose.rot.w >> pose.trans.x >> pose.trans.y >> pose.trans.z;
+
+            RobotBase::ManipulatorPtr manip = robot_ptr_->GetActiveManipulator();
+            if ( !manip || manip->GetArmIndices() != robot_ptr_->GetActiveDOFIndices() )
+            {
+                RAVELOG_ERROR("PRMProblem::RunGoalSetQuery - active dofs must be the arm of the active manipulator for ikgoal\n");
+                return false;
+            }
+
+            std::vector< std::vector<dReal> > solutions;
+            manip->FindIKSolutions(IkParameterization(pose), solutions, IKFO_CheckEnvCollisions);
+            FOREACHC(itsol, solutions)
+                goal_configs_.insert(goal_configs_.end(), itsol->begin(), itsol->end());
+        }
+        else if ( cmd == "execute" )
+            sinput >> execute;
+        else if ( cmd == "outputtraj" )
+            output_traj = true;
+        else if ( cmd == "savetraj" )
+            savetraj = getfilename_withseparator(sinput, ';');
+        else if ( cmd == "trajformat" )
+            sinput >> traj_format;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( goal_configs_.size() == 0 )
+    {
+        RAVELOG_ERROR("PRMProblem::RunGoalSetQuery - no goals specified\n");
+        return false;
+    }
+
+    /// one robot state saver for every check of the query
+    EdgeValidator::QueryScope scope(*validator_);
+
+    if ( !CheckEndPoint(start.config) )
+    {
+        RAVELOG_WARN("PRMProblem::RunGoalSetQuery - start in collision\n");
+        return false;
+    }
+
+    vertex_t vstart;
+    if ( !ConnectToRoadMap(start.config, vstart) )
+    {
+        RAVELOG_WARN("PRMProblem::RunGoalSetQuery - failed to connect start to the roadmap\n");
+        return false;
+    }
+
+    /// every goal that connects becomes an edge to the virtual super goal
+    goalset_.clear();
+    int num_goals = goal_configs_.size()/dof;
+    for ( int i = 0; i < num_goals; i++ )
+    {
+        goal.config.assign(goal_configs_.begin() + i*dof, goal_configs_.begin() + (i + 1)*dof);
+
+        vertex_t v;
+        if ( !CheckEndPoint(goal.config) || !ConnectToRoadMap(goal.config, v) )
+            continue;
+
+        goalset_.vertices.push_back(v);
+        goalset_.costs.push_back(SpatialStructure::distance(goal.config, roadmap_->getConfig(v)));
+        goalset_.goals.push_back(i);
+        goalset_.configs.insert(goalset_.configs.end(), goal.config.begin(), goal.config.end());
+    }
+
+    int reached = goalset_.vertices.size() > 0 ? FindPathToAny(vstart, goalset_, path_buffer_) : -1;
+    if ( reached < 0 )
+    {
+        RAVELOG_WARN(str(boost::format("PRMProblem::RunGoalSetQuery - none of %d goals reachable\n")%num_goals));
+        return false;
+    }
+
+    scope.End();
+
+    goal.config.assign(goal_configs_.begin() + reached*dof, goal_configs_.begin() + (reached + 1)*dof);
+
+    TrajectoryBasePtr traj = RaveCreateTrajectory(GetEnv(), dof);
+    traj->AddPoint(Trajectory::TPOINT(start.config, 0));
+    FOREACHC(it, path_buffer_)
+        traj->AddPoint(Trajectory::TPOINT(roadmap_->getConfig(*it), 0));
+    traj->AddPoint(Trajectory::TPOINT(goal.config, 0));
+
+    sout << reached << " ";
+
+    boost::shared_ptr<ostream> pout;
+    if ( output_traj )
+        pout.reset(&sout, null_deleter());
+
+    SetActiveTrajectory(robot_ptr_, traj, execute, savetraj, pout, traj_format);
+
+    return true;
+}
+
+
+
+
+bool PRMProblem::BinaryQuery(ostream &sout, istream &sinput)
+{
+    const uint8_t* input = NULL;
+    size_t input_size = 0;
+    uint8_t* output = NULL;
+    size_t output_capacity = 0;
+    string cmd;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        if ( cmd == "in" )
+        {
+            sinput >> binary_text_;
+            if ( !Base64Decode(binary_text_, binary_in_) )
+            {
+                RAVELOG_ERROR("PRMProblem::BinaryQuery - malformed base64 input\n");
+                return false;
+            }
+            input = binary_in_.size() > 0 ? &binary_in_[0] : NULL;
+            input_size = binary_in_.size();
+        }
+#ifdef OPENPRM_BINARY_POINTERS
+        else if ( cmd == "inptr" )
+        {
+            uintptr_t address;
+            sinput >> address >> input_size;
+            input = reinterpret_cast<const uint8_t*>(address);
+        }
+        else if ( cmd == "outptr" )
+        {
+            uintptr_t address;
+            sinput >> address >> output_capacity;
+            output = reinterpret_cast<uint8_t*>(address);
+        }
+#endif
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( !roadmap_ || roadmap_->numVertices() == 0 )
+    {
+        RAVELOG_ERROR("PRMProblem::BinaryQuery - no roadmap, call BuildRoadMap first\n");
+        return false;
+    }
+
+    if ( input == NULL || input_size < 12 )
+    {
+        RAVELOG_ERROR("PRMProblem::BinaryQuery - no request\n");
+        return false;
+    }
+
+    uint32_t version = GetUInt32LE(input);
+    uint32_t count = GetUInt32LE(input + 4);
+    uint32_t dof = GetUInt32LE(input + 8);
+    if ( version != BINARY_CHANNEL_VERSION || (int)dof != roadmap_->getDimension() || input_size < 12 + (size_t)count*2*dof*8 )
+    {
+        RAVELOG_ERROR("PRMProblem::BinaryQuery - request does not match the protocol version or roadmap dimension\n");
+        return false;
+    }
+
+    /// one robot state saver for every check of the query
+    EdgeValidator::QueryScope scope(*validator_);
+
+    ScopedConfig start(dof), goal(dof);
+    PackedWriter writer(binary_out_, output, output_capacity);
+    writer.putUInt32(BINARY_CHANNEL_VERSION);
+    writer.putUInt32(count);
+
+    const uint8_t* p = input + 12;
+    for ( uint32_t q = 0; q < count; q++ )
+    {
+        for ( uint32_t i = 0; i < dof; i++, p += 8 )
+            start.config[i] = GetDoubleLE(p);
+        for ( uint32_t i = 0; i < dof; i++, p += 8 )
+            goal.config[i] = GetDoubleLE(p);
+
+        vertex_t vstart, vgoal;
+        if ( !CheckEndPoint(start.config) || !CheckEndPoint(goal.config) ||
+             !ConnectToRoadMap(start.config, vstart) || !ConnectToRoadMap(goal.config, vgoal) || !FindPath(vstart, vgoal, path_buffer_) )
+        {
+            writer.putUInt32(0);
+            continue;
+        }
+
+        writer.putUInt32(path_buffer_.size() + 2);
+        writer.putConfig(start.config);
+        FOREACHC(it, path_buffer_)
+            writer.putConfig(roadmap_->getConfig(*it));
+        writer.putConfig(goal.config);
+    }
+
+    /// with caller memory only a status and the size go back, too small a buffer reports
+    /// the size needed. The command still succeeds, openravepy drops the output of a failure
+    if ( output != NULL )
+    {
+        sout << (writer.overflow() ? "overflow " : "ok ") << writer.size();
+        return true;
+    }
+
+    binary_text_.clear();
+    Base64Encode(binary_out_.size() > 0 ? &binary_out_[0] : NULL, binary_out_.size(), binary_text_);
+    sout << binary_text_;
+
+    return true;
+}
+
+
+
+
+bool PRMProblem::TestPrmGraph(ostream &sout, istream &sinput)
+{
+    RAVELOG_WARN("Not implemented yet\n");
+    return false;
+}
+
+
+
+
+bool PRMProblem::GetStats(ostream &sout, istream &sinput)
+{
+    const ConfigPool& pool = ConfigPool::local();
+    sout << "config_acquisitions " << pool.acquisitions() << " config_allocations " << pool.allocations();
+
+    if ( !!roadmap_ )
+    {
+        const SpatialStructure::Stats& stats = roadmap_->getStats();
+        sout << " nodes " << roadmap_->numVertices() << " edges " << roadmap_->numEdges()
+             << " searches " << stats.searches << " search_buffer_growths " << stats.buffer_growths;
+    }
+
+    if ( !!roadmap_ )
+        sout << " memory_bytes " << roadmap_->memoryUsage() << " idle_vertices " << idle_vertices_;
+
+    if ( !!roadmap_ && roadmap_->isPaged() )
+    {
+        const RoadMapPager::Stats& stats = roadmap_->getPager()->getStats();
+        sout << " block_loads " << stats.loads << " block_hits " << stats.hits << " block_evictions " << stats.evictions
+             << " block_prefetches " << stats.prefetches << " block_bytes_read " << stats.bytes_read;
+    }
+
+    if ( cost_history_.size() > 0 )
+    {
+        sout << " best_cost";
+        FOREACHC(it, cost_history_)
+            sout << " " << it->first << ":" << it->second;
+    }
+
+    if ( !!validator_ )
+    {
+        const EdgeValidator::Stats& stats = validator_->GetStats();
+        sout << " config_checks " << stats.config_checks << " edge_checks " << stats.edge_checks
+             << " edges_advanced " << stats.edges_advanced << " edges_bisected " << stats.edges_bisected
+             << " batches " << stats.batches << " batch_jobs " << stats.batch_jobs
+             << " state_reuses " << stats.state_reuses << " duplicates " << stats.duplicates
+             << " state_saves " << stats.state_saves;
+    }
+
+    return true;
+}
+
+
+
+
+void PRMProblem::CreateRoadMap()
+{
+    int dof = robot_ptr_->GetActiveDOF();
+
+    roadmap_.reset(new SpatialStructure(params_->max_nodes_, params_->max_edges_, dof));
+    roadmap_dofs_ = robot_ptr_->GetActiveDOFIndices();
+    roadmap_affine_ = robot_ptr_->GetAffineDOF();
+    ApplyRoadMapLimits();
+
+    robot_ptr_->GetActiveDOFLimits(lower_limits_, upper_limits_);
+
+    /// the active dofs may have changed since the validator was made
+    validator_->UpdateBounds();
+
+    grasp_layers_.clear();
+    grasp_order_.clear();
+    UpdateGraspLayer();
+
+    /// gamma > 2 ((1 + 1/d) mu(X_free) / zeta_d)^(1/d), with the joint limit box
+    /// bounding mu(X_free) and zeta_d the volume of the unit ball
+    dReal volume = 1;
+    for ( int i = 0; i < dof; i++ )
+        volume *= upper_limits_[i] - lower_limits_[i];
+
+    dReal zeta = (dof % 2 == 0) ? 1 : 2;
+    for ( int i = (dof % 2 == 0) ? 2 : 3; i <= dof; i += 2 )
+        zeta *= 2*PI/i;
+
+    prmstar_gamma_ = dReal(1.1)*2*RavePow((1 + dReal(1)/dof)*volume/zeta, dReal(1)/dof);
+    kprmstar_k_ = dReal(1.1)*dReal(M_E)*(1 + dReal(1)/dof);
+}
+
+
+
+
+bool PRMProblem::RoadMapMatchesRobot()
+{
+    return robot_ptr_->GetActiveDOFIndices() == roadmap_dofs_ && robot_ptr_->GetAffineDOF() == roadmap_affine_;
+}
+
+
+
+
+bool PRMProblem::CheckEndPoint(const vector<dReal> &config)
+{
+    if ( !validator_->CheckConfig(config) )
+        return false;
+
+    /// with a grasp the carried bodies have to be free as well
+    return !validator_->IsGrabbing() || validator_->CheckConfig(config, EdgeValidator::CT_Grabbed);
+}
+
+
+
+
+void PRMProblem::ApplyRoadMapLimits()
+{
+    /// the shrinking connection sets of PRM* already keep the edges at O(n log n) and
+    /// its anytime loop grows the roadmap until the deadline, only the radius strategy is capped
+    if ( params_->connection_strategy_ == CS_Radius )
+        roadmap_->setLimits(params_->max_nodes_, params_->max_edges_);
+    else
+        roadmap_->setLimits(0, 0);
+}
+
+
+
+
+void PRMProblem::SampleConfig(vector<dReal> &config)
+{
+    config.resize(lower_limits_.size());
+    for ( size_t i = 0; i < config.size(); i++ )
+        config[i] = lower_limits_[i] + RaveRandomFloat()*(upper_limits_[i] - lower_limits_[i]);
+}
+
+
+
+
+const vector<vertex_t>& PRMProblem::Neighbors(const vector<dReal> &config)
+{
+    dReal n = roadmap_->numVertices() + 1;
+    dReal d = roadmap_->getDimension();
+
+    switch ( params_->connection_strategy_ )
+    {
+    case CS_PRMStar:
+        return roadmap_->nearVertices(config, prmstar_gamma_*RavePow(RaveLog(n)/n, 1/d));
+    case CS_KPRMStar:
+        return roadmap_->nearestVertices(config, (size_t)RaveCeil(kprmstar_k_*RaveLog(n)));
+    default:
+        return roadmap_->nearVertices(config, params_->neighbor_threshold_);
+    }
+}
+
+
+
+
+vertex_t PRMProblem::AddToRoadMap(const vector<dReal> &config, bool interruptible, bool unbounded)
+{
+    vertex_t v = roadmap_->addVertex(config, unbounded);
+    if ( v == boost::graph_traits<SpatialGraph>::null_vertex() )
+        return v;
+
+    const vector<vertex_t>& near = Neighbors(config);
+
+    if ( !interruptible )
+    {
+        /// validate all candidate edges in one coherent batch
+        FOREACHC(it, near)
+        {
+            if ( *it != v )
+                validator_->QueueEdge(config, roadmap_->getConfig(*it));
+        }
+        validator_->CheckQueued(batch_results_);
+
+        size_t job = 0;
+        FOREACHC(it, near)
+        {
+            if ( *it == v )
+                continue;
+
+            if ( batch_results_[job++] )
+                roadmap_->addEdge(v, *it, SpatialStructure::distance(config, roadmap_->getConfig(*it)), unbounded);
+        }
+
+        return v;
+    }
+
+    /// background growth checks edge by edge so it can give up the environment between them
+    FOREACHC(it, near)
+    {
+        if ( *it == v )
+            continue;
+
+        if ( IdleShouldYield() )
+            break;
+
+        const vector<dReal>& other = roadmap_->getConfig(*it);
+        if ( validator_->CheckEdge(config, other) )
+            roadmap_->addEdge(v, *it, SpatialStructure::distance(config, other), unbounded);
+    }
+
+    return v;
+}
+
+
+
+
+void PRMProblem::RemoveFromRoadMap(const vector<vertex_t> &vertices)
+{
+    const vector<vertex_t>& remap = roadmap_->removeVertices(vertices);
+
+    FOREACH(it, grasp_layers_)
+        it->second->remap(remap);
+
+    /// a path through removed vertices has no use anymore
+    best_path_.clear();
+}
+
+
+
+
+bool PRMProblem::ConnectToRoadMap(const vector<dReal> &config, vertex_t &v)
+{
+    const vector<vertex_t>& near = Neighbors(config);
+    FOREACHC(it, near)
+    {
+        const vector<dReal>& other = roadmap_->getConfig(*it);
+        if ( !validator_->CheckEdge(config, other) )
+            continue;
+
+        /// the connecting edge is not part of the roadmap, check the grasp right away
+        if ( !!grasp_layer_ && !validator_->CheckEdge(config, other, EdgeValidator::CT_Grabbed) )
+            continue;
+
+        v = *it;
+        return true;
+    }
+
+    return false;
+}
+
+
+
+
+bool PRMProblem::FindPath(vertex_t start, vertex_t goal, vector<vertex_t> &path)
+{
+    if ( !grasp_layer_ )
+        return roadmap_->shortestPath(start, goal, path);
+
+    /// the search can only route around what is blocked between the end points
+    if ( !CheckVertexOnLayer(start) || !CheckVertexOnLayer(goal) )
+        return false;
+
+    /// lazy search: each rejected path marks at least one vertex or edge as blocked
+    while ( roadmap_->shortestPath(start, goal, path, grasp_layer_.get()) )
+    {
+        if ( CheckPathOnLayer(path) )
+            return true;
+    }
+
+    return false;
+}
+
+
+
+
+bool PRMProblem::ConnectWithRRT(vertex_t v, uint64_t deadline)
+{
+    int dof = roadmap_->getDimension();
+
+    /// graph storage moves when vertices are added, work on a copy
+    ScopedConfig root(dof), node(dof);
+    root.config = roadmap_->getConfig(v);
+
+    rrt_targets_.clear();
+    rrt_target_vertices_.clear();
+    const vector<vertex_t>& near = roadmap_->nearestVertices(root.config, params_->rrt_targets_ + 1);
+    FOREACHC(it, near)
+    {
+        if ( *it == v )
+            continue;
+
+        const vector<dReal>& target = roadmap_->getConfig(*it);
+        rrt_targets_.insert(rrt_targets_.end(), target.begin(), target.end());
+        rrt_target_vertices_.push_back(*it);
+    }
+
+    if ( rrt_target_vertices_.size() == 0 )
+        return false;
+
+    int reached = rrt_->Connect(root.config, rrt_targets_, deadline, rrt_branch_);
+    if ( reached < 0 )
+        return false;
+
+    /// merge the branch into the roadmap so later queries can use it. A branch that
+    /// does not fit or only joins query end points is removed with them after the query
+    vertex_t target = rrt_target_vertices_[reached];
+    size_t branch_vertices = rrt_branch_.size()/dof;
+    bool temporary = !roadmap_->hasRoom(branch_vertices, branch_vertices + 1) ||
+                     std::find(query_vertices_.begin(), query_vertices_.end(), target) != query_vertices_.end();
+
+    vertex_t previous = v;
+    for ( size_t offset = 0; offset + dof <= rrt_branch_.size(); offset += dof )
+    {
+        node.config.assign(rrt_branch_.begin() + offset, rrt_branch_.begin() + offset + dof);
+
+        vertex_t u = roadmap_->addVertex(node.config, temporary);
+        if ( u == boost::graph_traits<SpatialGraph>::null_vertex() )
+            return false;
+        if ( temporary )
+            query_vertices_.push_back(u);
+
+        roadmap_->addEdge(previous, u, SpatialStructure::distance(roadmap_->getConfig(previous), node.config), temporary);
+        previous = u;
+    }
+
+    roadmap_->addEdge(previous, target, SpatialStructure::distance(roadmap_->getConfig(previous), roadmap_->getConfig(target)), temporary);
+
+    RAVELOG_DEBUG(str(boost::format("PRMProblem::ConnectWithRRT - merged %d %s rrt vertices\n")%branch_vertices%(temporary ? "temporary" : "permanent")));
+    return true;
+}
+
+
+
+
+int PRMProblem::FindPathToAny(vertex_t start, GoalSet &goalset, vector<vertex_t> &path)
+{
+    if ( !grasp_layer_ )
+        return roadmap_->shortestPathToAny(start, goalset, path);
+
+    if ( !CheckVertexOnLayer(start) )
+        return -1;
+
+    /// drop goal vertices the grasp cannot reach, the rest must stay free for the lazy search
+    size_t kept = 0;
+    for ( size_t i = 0; i < goalset.vertices.size(); i++ )
+    {
+        if ( !CheckVertexOnLayer(goalset.vertices[i]) )
+            continue;
+
+        goalset.vertices[kept] = goalset.vertices[i];
+        goalset.costs[kept] = goalset.costs[i];
+        goalset.goals[kept] = goalset.goals[i];
+        kept++;
+    }
+    goalset.vertices.resize(kept);
+    goalset.costs.resize(kept);
+    goalset.goals.resize(kept);
+
+    int goal;
+    while ( (goal = roadmap_->shortestPathToAny(start, goalset, path, grasp_layer_.get())) >= 0 )
+    {
+        if ( CheckPathOnLayer(path) )
+            return goal;
+    }
+
+    return -1;
+}
+
+
+
+
+bool PRMProblem::CheckVertexOnLayer(vertex_t v)
+{
+    GraspLayer::State state = grasp_layer_->vertexState(v);
+    if ( state == GraspLayer::GS_Unknown )
+    {
+        state = validator_->CheckConfig(roadmap_->getConfig(v), EdgeValidator::CT_Grabbed) ? GraspLayer::GS_Free : GraspLayer::GS_Blocked;
+        grasp_layer_->setVertexState(v, state);
+    }
+
+    return state == GraspLayer::GS_Free;
+}
+
+
+
+
+bool PRMProblem::CheckPathOnLayer(const vector<vertex_t> &path)
+{
+    /// vertices first, edges are only worth checking between free vertices
+    layer_pending_.clear();
+    FOREACHC(it, path)
+    {
+        if ( grasp_layer_->vertexState(*it) == GraspLayer::GS_Unknown )
+        {
+            validator_->QueueConfig(roadmap_->getConfig(*it));
+            layer_pending_.push_back(std::make_pair(*it, *it));
+        }
+    }
+    validator_->CheckQueued(batch_results_, EdgeValidator::CT_Grabbed);
+
+    bool free = true;
+    for ( size_t i = 0; i < layer_pending_.size(); i++ )
+    {
+        grasp_layer_->setVertexState(layer_pending_[i].first, batch_results_[i] ? GraspLayer::GS_Free : GraspLayer::GS_Blocked);
+        free = free && batch_results_[i];
+    }
+
+    if ( !free )
+        return false;
+
+    layer_pending_.clear();
+    for ( size_t i = 1; i < path.size(); i++ )
+    {
+        if ( grasp_layer_->edgeState(path[i-1], path[i]) == GraspLayer::GS_Unknown )
+        {
+            validator_->QueueEdge(roadmap_->getConfig(path[i-1]), roadmap_->getConfig(path[i]));
+            layer_pending_.push_back(std::make_pair(path[i-1], path[i]));
+        }
+    }
+    validator_->CheckQueued(batch_results_, EdgeValidator::CT_Grabbed);
+
+    for ( size_t i = 0; i < layer_pending_.size(); i++ )
+    {
+        grasp_layer_->setEdgeState(layer_pending_[i].first, layer_pending_[i].second, batch_results_[i] ? GraspLayer::GS_Free : GraspLayer::GS_Blocked);
+        free = free && batch_results_[i];
+    }
+
+    return free;
+}
+
+
+
+
+void PRMProblem::UpdateGraspLayer()
+{
+    grasp_layer_.reset();
+    if ( !validator_ || !validator_->IsGrabbing() )
+        return;
+
+    GraspKey key = GraspLayer::makeKey(robot_ptr_);
+    GraspLayerPtr& layer = grasp_layers_[key];
+    if ( !layer )
+        layer.reset(new GraspLayer());
+    else
+        grasp_order_.remove(key);
+
+    grasp_layer_ = layer;
+    grasp_order_.push_front(key);
+
+    /// every layer holds state for the whole roadmap, keep only the recent grasps
+    while ( grasp_order_.size() > std::max(params_->max_grasp_layers_, 1u) )
+    {
+        grasp_layers_.erase(grasp_order_.back());
+        grasp_order_.pop_back();
+    }
+}
+
+
+
+
+bool PRMProblem::IdleGrowth(ostream &sout, istream &sinput)
+{
+    bool enable = true;
+    string cmd;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "on" )
+            enable = true;
+        else if ( cmd == "off" )
+            enable = false;
+        else if ( cmd == "memorylimit" )
+            sinput >> params_->idle_memory_limit_;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( enable )
+    {
+        if ( !validator_ )
+        {
+            RAVELOG_ERROR("PRMProblem::IdleGrowth - no robot to plan for\n");
+            return false;
+        }
+
+        StartIdleGrowth();
+    }
+    else
+        StopIdleGrowth();
+
+    return true;
+}
+
+
+
+
+void PRMProblem::StartIdleGrowth()
+{
+    if ( !!idle_thread_ )
+        return;
+
+    {
+        boost::mutex::scoped_lock lock(idle_mutex_);
+        idle_stop_ = false;
+    }
+
+    /// normal priority on purpose, a starved thread holding the environment
+    /// would delay the very commands it yields to
+    idle_thread_.reset(new boost::thread(boost::bind(&PRMProblem::IdleGrowthThread, this)));
+}
+
+
+
+
+void PRMProblem::StopIdleGrowth()
+{
+    if ( !idle_thread_ )
+        return;
+
+    {
+        boost::mutex::scoped_lock lock(idle_mutex_);
+        idle_stop_ = true;
+    }
+
+    /// the thread only ever try-locks the environment, so joining while holding it is safe
+    idle_thread_->join();
+    idle_thread_.reset();
+}
+
+
+
+
+bool PRMProblem::IdleShouldYield()
+{
+    boost::mutex::scoped_lock lock(idle_mutex_);
+    return idle_stop_ || pending_commands_ > 0;
+}
+
+
+
+
+void PRMProblem::IdleGrowthThread()
+{
+    RAVELOG_DEBUG("PRMProblem::IdleGrowthThread - started\n");
+
+    std::vector<dReal> sample;
+    while ( true )
+    {
+        {
+            boost::mutex::scoped_lock lock(idle_mutex_);
+            if ( idle_stop_ )
+                break;
+        }
+
+        if ( IdleShouldYield() )
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            continue;
+        }
+
+        EnvironmentMutex::scoped_try_lock lock(GetEnv()->GetMutex());
+        if ( !lock.owns_lock() )
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            continue;
+        }
+
+        /// nothing may escape the thread, failed block reads or writes of a paged
+        /// roadmap and validator errors stop the growth instead
+        try
+        {
+            /// background growth is bounded by memory only, not by the node limit of BuildRoadMap,
+            /// and waits while the active dofs differ from those the roadmap was built for
+            if ( !roadmap_ || !RoadMapMatchesRobot() ||
+                 roadmap_->memoryUsage() >= (size_t)(params_->idle_memory_limit_*1024*1024) )
+            {
+                lock.unlock();
+                boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+                continue;
+            }
+
+            SampleConfig(sample);
+            if ( validator_->CheckConfig(sample) &&
+                 AddToRoadMap(sample, true, true) != boost::graph_traits<SpatialGraph>::null_vertex() )
+                idle_vertices_++;
+            roadmap_->spill();
+
+            /// a renumbering cannot be interrupted, only start one while no command waits
+            if ( !IdleShouldYield() )
+                RenumberRoadMap(false);
+        }
+        catch ( const std::exception& e )
+        {
+            RAVELOG_ERROR(str(boost::format("PRMProblem::IdleGrowthThread - %s\n")%e.what()));
+            break;
+        }
+    }
+
+    RAVELOG_DEBUG("PRMProblem::IdleGrowthThread - stopped\n");
+}
+
+
+
+
+bool PRMProblem::ReorderRoadMap(ostream &sout, istream &sinput)
+{
+    if ( !roadmap_ )
+    {
+        RAVELOG_ERROR("PRMProblem::ReorderRoadMap - no roadmap, call BuildRoadMap first\n");
+        return false;
+    }
+
+    RenumberRoadMap(true);
+    return true;
+}
+
+
+
+
+bool PRMProblem::PageRoadMap(ostream &sout, istream &sinput)
+{
+    string file, cmd;
+    bool overwrite = false;
+
+    while (!sinput.eof())
+    {
+        sinput >> cmd;
+        if ( !sinput )
+            break;
+
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if ( cmd == "file" )
+            sinput >> file;
+        else if ( cmd == "overwrite" )
+            overwrite = true;
+        else if ( cmd == "blocksize" )
+            sinput >> params_->page_block_size_;
+        else if ( cmd == "cacheblocks" )
+            sinput >> params_->page_cache_blocks_;
+        else
+        {
+            RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+            break;
+        }
+
+        if ( !sinput )
+        {
+            RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+            return false;
+        }
+    }
+
+    if ( !roadmap_ )
+    {
+        RAVELOG_ERROR("PRMProblem::PageRoadMap - no roadmap, call BuildRoadMap first\n");
+        return false;
+    }
+
+    if ( file.empty() )
+    {
+        RAVELOG_ERROR("PRMProblem::PageRoadMap - no file given\n");
+        return false;
+    }
+
+    /// blocks of consecutive ids are only coherent after a renumbering
+    RenumberRoadMap(true);
+    if ( !roadmap_->page(file, params_->page_block_size_, params_->page_cache_blocks_, overwrite) )
+        return false;
+
+    RAVELOG_INFO(str(boost::format("PRMProblem::PageRoadMap - %d of %d vertices in %d blocks of %s\n")
+                     %roadmap_->getPager()->numVertices()%roadmap_->numVertices()%roadmap_->getPager()->numBlocks()%file));
+    return true;
+}
+
+
+
+
+bool PRMProblem::FlushTrajectoryFiles(ostream &sout, istream &sinput)
+{
+    if ( !!traj_writer_ )
+        traj_writer_->Flush();
+    return true;
+}
+
+
+
+
+void PRMProblem::RenumberRoadMap(bool force)
+{
+    /// a paged roadmap keeps the numbering of its block file
+    if ( !roadmap_ || roadmap_->numVertices() == 0 || roadmap_->isPaged() )
+        return;
+
+    if ( !force && (params_->reorder_threshold_ == 0 || roadmap_->verticesSinceReorder() < (int)params_->reorder_threshold_) )
+        return;
+
+    const vector<vertex_t>& remap = roadmap_->reorder(lower_limits_, upper_limits_);
+
+    /// the grasp layers are the only vertex handles kept across commands
+    FOREACH(it, grasp_layers_)
+        it->second->remap(remap);
+
+    RAVELOG_DEBUG(str(boost::format("PRMProblem::RenumberRoadMap - renumbered %d vertices\n")%roadmap_->numVertices()));
 }
@@ -0,0 +1,321 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <roadmap_pager.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace OpenRAVE;
+using namespace openprm;
+
+
+RoadMapPager::RoadMapPager(int dimension, size_t block_size, size_t cache_blocks) :
+    dimension_(dimension),
+    block_size_(std::max(block_size, (size_t)1)),
+    cache_blocks_(std::max(cache_blocks, (size_t)2)),
+    vertices_(0),
+    write_offset_(0),
+    fd_(-1),
+    tick_(0)
+{
+}
+
+
+
+
+RoadMapPager::~RoadMapPager()
+{
+    if ( fd_ >= 0 )
+        close(fd_);
+}
+
+
+
+
+bool RoadMapPager::create(const std::string &file, bool overwrite)
+{
+    /// O_EXCL so an existing file is never silently replaced
+    fd_ = open(file.c_str(), O_RDWR | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), 0600);
+    if ( fd_ < 0 )
+    {
+        RAVELOG_ERROR(str(boost::format("RoadMapPager::create - %s exists or cannot be created, pass overwrite to replace it\n")%file));
+        return false;
+    }
+
+    /// the open descriptor keeps the data, nothing is left behind on disk
+    file_ = file;
+    if ( unlink(file_.c_str()) != 0 )
+        RAVELOG_WARN(str(boost::format("RoadMapPager::create - cannot unlink %s\n")%file_));
+
+    index_.clear();
+    slots_.clear();
+    slot_of_.clear();
+    vertices_ = 0;
+    write_offset_ = 0;
+    return true;
+}
+
+
+
+
+bool RoadMapPager::appendBlock(const Block &block)
+{
+    /// block ids follow from vertex ids only while every block is full
+    if ( fd_ < 0 || block.size() != block_size_ )
+    {
+        RAVELOG_ERROR("RoadMapPager::appendBlock - no block file or the block is not full\n");
+        return false;
+    }
+
+    BlockEntry entry;
+    if ( !store(block, entry) )
+        return false;
+
+    vertices_ += entry.vertices;
+    index_.push_back(entry);
+    slot_of_.push_back(-1);
+    if ( slots_.size() < cache_blocks_ )
+        slots_.push_back(CacheSlot());
+    return true;
+}
+
+
+
+
+bool RoadMapPager::rewriteBlock(size_t b, const Block &block)
+{
+    if ( b >= index_.size() || block.size() != index_[b].vertices )
+    {
+        RAVELOG_ERROR("RoadMapPager::rewriteBlock - block does not exist or its vertices differ\n");
+        return false;
+    }
+
+    BlockEntry entry;
+    if ( !store(block, entry) )
+        return false;
+    index_[b] = entry;
+
+    /// the cached copy is out of date
+    int s = slot_of_[b];
+    if ( s >= 0 )
+    {
+        slots_[s].block = -1;
+        slots_[s].used = 0;
+        slot_of_[b] = -1;
+    }
+    return true;
+}
+
+
+
+
+const RoadMapPager::Block& RoadMapPager::block(size_t b)
+{
+    tick_++;
+
+    int s = slot_of_[b];
+    if ( s >= 0 )
+    {
+        stats_.hits++;
+        slots_[s].used = tick_;
+        return slots_[s].data;
+    }
+
+    if ( slots_.empty() )
+        throw openrave_exception(str(boost::format("RoadMapPager::block - block %d of an empty block file")%b));
+
+    /// least recently used slot, which is never the block handed out last
+    s = 0;
+    for ( size_t i = 1; i < slots_.size(); i++ )
+        if ( slots_[i].used < slots_[s].used )
+            s = i;
+
+    CacheSlot& slot = slots_[s];
+    if ( slot.block >= 0 )
+    {
+        slot_of_[slot.block] = -1;
+        stats_.evictions++;
+    }
+
+    slot.block = -1;
+    if ( !load(b, slot.data) )
+        throw openrave_exception(str(boost::format("RoadMapPager::block - failed to read block %d of %s")%b%file_));
+
+    slot.block = b;
+    slot.used = tick_;
+    slot_of_[b] = s;
+    return slot.data;
+}
+
+
+
+
+void RoadMapPager::prefetch(size_t b)
+{
+    if ( fd_ < 0 || slot_of_[b] >= 0 )
+        return;
+
+    stats_.prefetches++;
+#ifdef POSIX_FADV_WILLNEED
+    const BlockEntry& entry = index_[b];
+    posix_fadvise(fd_, entry.offset, blockBytes(entry), POSIX_FADV_WILLNEED);
+#endif
+}
+
+
+
+
+dReal RoadMapPager::boxDistance(size_t b, const std::vector<dReal> &config) const
+{
+    const BlockEntry& entry = index_[b];
+    dReal d = 0;
+    for ( int i = 0; i < dimension_; i++ )
+    {
+        dReal outside = std::max(entry.lower[i] - config[i], config[i] - entry.upper[i]);
+        if ( outside > 0 )
+            d += outside*outside;
+    }
+    return RaveSqrt(d);
+}
+
+
+
+
+size_t RoadMapPager::memoryUsage() const
+{
+    size_t bytes = index_.size()*(sizeof(BlockEntry) + 2*dimension_*sizeof(dReal)) + slot_of_.size()*sizeof(int);
+    FOREACHC(it, slots_)
+        bytes += it->data.size()*(sizeof(std::vector<dReal>) + dimension_*sizeof(dReal) + sizeof(uint32_t))
+                 + it->data.targets.size()*(sizeof(uint32_t) + sizeof(dReal));
+    return bytes + read_buffer_.capacity() + write_buffer_.capacity();
+}
+
+
+
+
+size_t RoadMapPager::blockBytes(const BlockEntry &entry) const
+{
+    return entry.vertices*dimension_*sizeof(dReal) + (entry.vertices + 1)*sizeof(uint32_t)
+           + entry.edges*(sizeof(uint32_t) + sizeof(dReal));
+}
+
+
+
+
+bool RoadMapPager::load(size_t b, Block &data)
+{
+    const BlockEntry& entry = index_[b];
+    size_t bytes = blockBytes(entry);
+
+    read_buffer_.resize(bytes);
+    size_t done = 0;
+    while ( done < bytes )
+    {
+        ssize_t got = pread(fd_, &read_buffer_[done], bytes - done, entry.offset + done);
+        if ( got <= 0 )
+            return false;
+        done += got;
+    }
+
+    stats_.loads++;
+    stats_.bytes_read += bytes;
+
+    /// slot storage is reused, only a short last block changes its shape
+    const uint8_t* p = &read_buffer_[0];
+    data.configs.resize(entry.vertices);
+    FOREACH(it, data.configs)
+    {
+        it->resize(dimension_);
+        memcpy(&(*it)[0], p, dimension_*sizeof(dReal));
+        p += dimension_*sizeof(dReal);
+    }
+
+    data.offsets.resize(entry.vertices + 1);
+    memcpy(&data.offsets[0], p, data.offsets.size()*sizeof(uint32_t));
+    p += data.offsets.size()*sizeof(uint32_t);
+
+    data.targets.resize(entry.edges);
+    data.lengths.resize(entry.edges);
+    if ( entry.edges > 0 )
+    {
+        memcpy(&data.targets[0], p, entry.edges*sizeof(uint32_t));
+        p += entry.edges*sizeof(uint32_t);
+        memcpy(&data.lengths[0], p, entry.edges*sizeof(dReal));
+    }
+
+    return true;
+}
+
+
+
+
+bool RoadMapPager::store(const Block &block, BlockEntry &entry)
+{
+    entry.offset = write_offset_;
+    entry.vertices = block.size();
+    entry.edges = block.targets.size();
+    entry.lower.assign(dimension_, std::numeric_limits<dReal>::infinity());
+    entry.upper.assign(dimension_, -std::numeric_limits<dReal>::infinity());
+
+    /// configurations, then the adjacency rows, all in native byte order
+    size_t bytes = blockBytes(entry);
+    write_buffer_.resize(bytes);
+    uint8_t* p = &write_buffer_[0];
+    FOREACHC(it, block.configs)
+    {
+        for ( int i = 0; i < dimension_; i++ )
+        {
+            entry.lower[i] = std::min(entry.lower[i], (*it)[i]);
+            entry.upper[i] = std::max(entry.upper[i], (*it)[i]);
+        }
+        memcpy(p, &(*it)[0], dimension_*sizeof(dReal));
+        p += dimension_*sizeof(dReal);
+    }
+    memcpy(p, &block.offsets[0], block.offsets.size()*sizeof(uint32_t));
+    p += block.offsets.size()*sizeof(uint32_t);
+    if ( entry.edges > 0 )
+    {
+        memcpy(p, &block.targets[0], entry.edges*sizeof(uint32_t));
+        p += entry.edges*sizeof(uint32_t);
+        memcpy(p, &block.lengths[0], entry.edges*sizeof(dReal));
+    }
+
+    size_t done = 0;
+    while ( done < bytes )
+    {
+        ssize_t put = pwrite(fd_, &write_buffer_[done], bytes - done, write_offset_ + done);
+        if ( put <= 0 )
+        {
+            RAVELOG_ERROR(str(boost::format("RoadMapPager::store - write to %s failed\n")%file_));
+            return false;
+        }
+        done += put;
+    }
+
+    write_offset_ += bytes;
+    return true;
+}
@@ -0,0 +1,174 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <rrt_connect.h>
+
+using namespace OpenRAVE;
+using namespace openprm;
+
+
+RRTConnect::RRTConnect(EdgeValidatorPtr validator, SampleFn sample, dReal step) :
+    validator_(validator),
+    sample_(sample),
+    step_(step),
+    dim_(0)
+{
+}
+
+
+
+
+int RRTConnect::Connect(const std::vector<dReal> &root, const std::vector<dReal> &targets, uint64_t deadline, std::vector<dReal> &branch)
+{
+    branch.clear();
+    dim_ = root.size();
+
+    Tree& root_tree = trees_[0];
+    Tree& target_tree = trees_[1];
+    root_tree.clear();
+    target_tree.clear();
+
+    addNode(root_tree, root, -1, -1);
+    for ( size_t offset = 0; offset + dim_ <= targets.size(); offset += dim_ )
+    {
+        target_.assign(targets.begin() + offset, targets.begin() + offset + dim_);
+        addNode(target_tree, target_, -1, offset/dim_);
+    }
+
+    if ( target_tree.size() == 0 )
+        return -1;
+
+    Tree* a = &root_tree;
+    Tree* b = &target_tree;
+    while ( GetMicroTime() < deadline )
+    {
+        sample_(target_);
+        if ( extend(*a, target_) != ER_Trapped )
+        {
+            /// pull the other tree towards the new node for as long as it advances
+            meet_.assign(a->configs.end() - dim_, a->configs.end());
+
+            ExtendResult result;
+            do
+            {
+                result = extend(*b, meet_);
+            }
+            while ( result == ER_Advanced && GetMicroTime() < deadline );
+
+            if ( result == ER_Reached )
+            {
+                /// the newest node of both trees is the meeting configuration
+                appendBranch(root_tree, root_tree.size() - 1, branch, true);
+                appendBranch(target_tree, target_tree.parents.back(), branch, false);
+                return target_tree.roots.back();
+            }
+        }
+
+        std::swap(a, b);
+    }
+
+    return -1;
+}
+
+
+
+
+RRTConnect::ExtendResult RRTConnect::extend(Tree &tree, const std::vector<dReal> &target)
+{
+    int n = nearest(tree, target);
+    near_.assign(tree.configs.begin() + n*dim_, tree.configs.begin() + (n + 1)*dim_);
+
+    dReal d = 0;
+    for ( size_t i = 0; i < dim_; i++ )
+        d += (target[i] - near_[i])*(target[i] - near_[i]);
+    d = RaveSqrt(d);
+
+    ExtendResult result = ER_Reached;
+    new_ = target;
+    if ( d > step_ )
+    {
+        for ( size_t i = 0; i < dim_; i++ )
+            new_[i] = near_[i] + (target[i] - near_[i])*step_/d;
+        result = ER_Advanced;
+    }
+
+    if ( !validator_->CheckConfig(new_) || !validator_->CheckEdge(near_, new_) )
+        return ER_Trapped;
+
+    addNode(tree, new_, n, tree.roots[n]);
+    return result;
+}
+
+
+
+
+int RRTConnect::nearest(const Tree &tree, const std::vector<dReal> &config) const
+{
+    int best = 0;
+    dReal best_distance = std::numeric_limits<dReal>::infinity();
+
+    for ( int n = 0; n < tree.size(); n++ )
+    {
+        dReal d = 0;
+        for ( size_t i = 0; i < dim_ && d < best_distance; i++ )
+            d += (config[i] - tree.configs[n*dim_ + i])*(config[i] - tree.configs[n*dim_ + i]);
+
+        if ( d < best_distance )
+        {
+            best_distance = d;
+            best = n;
+        }
+    }
+
+    return best;
+}
+
+
+
+
+void RRTConnect::addNode(Tree &tree, const std::vector<dReal> &config, int parent, int root)
+{
+    tree.configs.insert(tree.configs.end(), config.begin(), config.end());
+    tree.parents.push_back(parent);
+    tree.roots.push_back(root);
+}
+
+
+
+
+void RRTConnect::appendBranch(const Tree &tree, int node, std::vector<dReal> &branch, bool reverse)
+{
+    /// nodes from node up to, but not including, the root of its tree
+    chain_.clear();
+    for ( int n = node; n >= 0 && tree.parents[n] >= 0; n = tree.parents[n] )
+        chain_.push_back(n);
+
+    if ( reverse )
+        std::reverse(chain_.begin(), chain_.end());
+
+    FOREACHC(it, chain_)
+        branch.insert(branch.end(), tree.configs.begin() + (*it)*dim_, tree.configs.begin() + (*it + 1)*dim_);
+}
@@ -0,0 +1,240 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <trajectory_writer.h>
+#include <binary_channel.h>
+
+#include <fstream>
+#include <cstdio>
+
+using namespace OpenRAVE;
+using namespace openprm;
+
+
+namespace
+{
+
+/// points per chunk of binary output
+const size_t CHUNK_POINTS = 256;
+
+/// write out the front of chunk. Base64 output only takes whole groups of three
+/// bytes until the last chunk, so the encoded pieces join up to one encoding
+void flushChunk(std::vector<uint8_t>& chunk, std::ostream& out, bool base64, bool last, std::string& text)
+{
+    size_t n = base64 && !last ? chunk.size() - chunk.size() % 3 : chunk.size();
+    if ( n == 0 )
+        return;
+
+    if ( base64 )
+    {
+        text.clear();
+        Base64Encode(&chunk[0], n, text);
+        out.write(text.data(), text.size());
+    }
+    else
+        out.write(reinterpret_cast<const char*>(&chunk[0]), n);
+
+    chunk.erase(chunk.begin(), chunk.begin() + n);
+}
+
+}
+
+
+
+
+std::ostream& openprm::operator<<(std::ostream& O, TrajectoryFormat format)
+{
+    return O << (format == TF_Binary ? "binary" : "text");
+}
+
+
+
+
+std::istream& openprm::operator>>(std::istream& I, TrajectoryFormat& format)
+{
+    std::string name;
+    I >> name;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    if ( name == "text" )
+        format = TF_Text;
+    else if ( name == "binary" )
+        format = TF_Binary;
+    else
+        I.setstate(std::ios::failbit);
+
+    return I;
+}
+
+
+
+
+bool openprm::WriteBinaryTrajectory(const TrajectoryBase &traj, std::ostream &out, bool base64)
+{
+    const std::vector<Trajectory::TPOINT>& points = traj.GetPoints();
+    size_t dof = traj.GetDOF();
+    size_t point_bytes = 8*(1 + dof + 7);
+
+    std::vector<uint8_t> chunk;
+    std::string text;
+    chunk.reserve(12 + CHUNK_POINTS*point_bytes);
+
+    chunk.resize(12);
+    PutUInt32LE(&chunk[0], TRAJECTORY_FORMAT_VERSION);
+    PutUInt32LE(&chunk[4], dof);
+    PutUInt32LE(&chunk[8], points.size());
+
+    FOREACHC(it, points)
+    {
+        size_t offset = chunk.size();
+        chunk.resize(offset + point_bytes);
+        uint8_t* p = &chunk[offset];
+
+        PutDoubleLE(p, it->time);
+        p += 8;
+        for ( size_t i = 0; i < dof; i++, p += 8 )
+            PutDoubleLE(p, i < it->q.size() ? it->q[i] : 0);
+
+        const Transform& t = it->trans;
+        PutDoubleLE(p, t.trans.x);
+        PutDoubleLE(p + 8, t.trans.y);
+        PutDoubleLE(p + 16, t.trans.z);
+        PutDoubleLE(p + 24, t.rot.x);
+        PutDoubleLE(p + 32, t.rot.y);
+        PutDoubleLE(p + 40, t.rot.z);
+        PutDoubleLE(p + 48, t.rot.w);
+
+        if ( chunk.size() >= CHUNK_POINTS*point_bytes )
+            flushChunk(chunk, out, base64, false, text);
+    }
+
+    flushChunk(chunk, out, base64, true, text);
+    return !!out;
+}
+
+
+
+
+TrajectoryWriter::TrajectoryWriter() :
+    busy_(false),
+    stop_(false)
+{
+    thread_.reset(new boost::thread(boost::bind(&TrajectoryWriter::run, this)));
+}
+
+
+
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    thread_->join();
+}
+
+
+
+
+void TrajectoryWriter::Write(TrajectoryBaseConstPtr traj, const std::string &file, TrajectoryFormat format)
+{
+    Job job;
+    job.traj = traj;
+    job.file = file;
+    job.format = format;
+
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        jobs_.push_back(job);
+    }
+    changed_.notify_all();
+}
+
+
+
+
+void TrajectoryWriter::Flush()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    while ( !jobs_.empty() || busy_ )
+        changed_.wait(lock);
+}
+
+
+
+
+void TrajectoryWriter::run()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    while ( true )
+    {
+        /// queued files are still written when stopping
+        while ( jobs_.empty() && !stop_ )
+            changed_.wait(lock);
+
+        if ( jobs_.empty() )
+            break;
+
+        Job job = jobs_.front();
+        jobs_.pop_front();
+        busy_ = true;
+
+        lock.unlock();
+        writeFile(job);
+        job.traj.reset();
+        lock.lock();
+
+        busy_ = false;
+        changed_.notify_all();
+    }
+}
+
+
+
+
+void TrajectoryWriter::writeFile(const Job &job)
+{
+    std::string partial = job.file + ".part";
+    {
+        std::ofstream f(partial.c_str(), job.format == TF_Binary ? std::ios::out | std::ios::binary : std::ios::out);
+        if ( job.format == TF_Binary )
+            WriteBinaryTrajectory(*job.traj, f, false);
+        else
+            job.traj->Write(f, Trajectory::TO_IncludeTimestamps|Trajectory::TO_IncludeBaseTransformation);
+
+        if ( !f )
+        {
+            RAVELOG_ERROR(str(boost::format("TrajectoryWriter - failed writing %s\n")%job.file));
+            std::remove(partial.c_str());
+            return;
+        }
+    }
+
+    if ( std::rename(partial.c_str(), job.file.c_str()) != 0 )
+        RAVELOG_ERROR(str(boost::format("TrajectoryWriter - failed to rename %s to %s\n")%partial%job.file));
+}
@@ -0,0 +1,197 @@
+/// Copyright (c) 2010-2012, Billy Okal sudo@makokal.com
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+/// * Redistributions of source code must retain the above copyright
+///   notice, this list of conditions and the following disclaimer.
+/// * Redistributions in binary form must reproduce the above copyright
+///   notice, this list of conditions and the following disclaimer in the
+///   documentation and/or other materials provided with the distribution.
+/// * Neither the name of the author nor the
+///   names of its contributors may be used to endorse or promote products
+///   derived from this software without specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY the author ''AS IS'' AND ANY
+/// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL the author BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// Standalone check of the BinaryQuery wire format: byte order of the packed
+/// fields, base64 with and without padding, and how PackedWriter accounts for
+/// caller memory that is too small. Needs no environment, returns nonzero on failure
+
+#include <binary_channel.h>
+
+#include <cstdio>
+
+using namespace openprm;
+
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { if ( !(cond) ) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } } while ( 0 )
+
+
+void testByteOrder()
+{
+    uint8_t p[8];
+
+    PutUInt32LE(p, 0x04030201);
+    CHECK(p[0] == 1 && p[1] == 2 && p[2] == 3 && p[3] == 4);
+    CHECK(GetUInt32LE(p) == 0x04030201);
+
+    /// 1.0 is 0x3ff0000000000000
+    PutDoubleLE(p, 1.0);
+    CHECK(p[0] == 0 && p[5] == 0 && p[6] == 0xf0 && p[7] == 0x3f);
+    CHECK(GetDoubleLE(p) == 1.0);
+
+    PutDoubleLE(p, -0.1);
+    CHECK(GetDoubleLE(p) == -0.1);
+}
+
+
+void testBase64()
+{
+    const char* plain[] = { "", "M", "Ma", "Man", "Many" };
+    const char* encoded[] = { "", "TQ==", "TWE=", "TWFu", "TWFueQ==" };
+
+    for ( int i = 0; i < 5; i++ )
+    {
+        std::string text;
+        Base64Encode(reinterpret_cast<const uint8_t*>(plain[i]), std::strlen(plain[i]), text);
+        CHECK(text == encoded[i]);
+
+        std::vector<uint8_t> data;
+        CHECK(Base64Decode(text, data));
+        CHECK(std::string(data.begin(), data.end()) == plain[i]);
+    }
+
+    /// every byte value and every padding length
+    std::vector<uint8_t> bytes;
+    for ( int i = 0; i < 258; i++ )
+        bytes.push_back(i & 0xff);
+
+    for ( size_t size = 0; size <= bytes.size(); size += 37 )
+    {
+        std::string text;
+        Base64Encode(size > 0 ? &bytes[0] : NULL, size, text);
+        CHECK(text.size() == 4*((size + 2)/3));
+
+        std::vector<uint8_t> data;
+        CHECK(Base64Decode(text, data));
+        CHECK(data.size() == size && std::equal(data.begin(), data.end(), bytes.begin()));
+    }
+
+    /// Base64Encode appends
+    std::string text = "x";
+    Base64Encode(reinterpret_cast<const uint8_t*>("Man"), 3, text);
+    CHECK(text == "xTWFu");
+
+    std::vector<uint8_t> data;
+    CHECK(!Base64Decode("TW-u", data));
+    CHECK(!Base64Decode("TW u", data));
+}
+
+
+void testPackedWriter()
+{
+    std::vector<dReal> config(2);
+    config[0] = 1.0;
+    config[1] = -2.5;
+
+    /// into the reusable buffer: version, count, one path of two points
+    std::vector<uint8_t> buffer(5, 0xff);
+    PackedWriter writer(buffer, NULL, 0);
+    writer.putUInt32(BINARY_CHANNEL_VERSION);
+    writer.putUInt32(1);
+    writer.putUInt32(2);
+    writer.putConfig(config);
+    writer.putConfig(config);
+
+    CHECK(!writer.overflow());
+    CHECK(writer.size() == 12 + 2*2*8);
+    CHECK(buffer.size() == writer.size());
+    CHECK(GetUInt32LE(&buffer[0]) == BINARY_CHANNEL_VERSION);
+    CHECK(GetUInt32LE(&buffer[4]) == 1);
+    CHECK(GetUInt32LE(&buffer[8]) == 2);
+    CHECK(GetDoubleLE(&buffer[12]) == 1.0 && GetDoubleLE(&buffer[20]) == -2.5);
+    CHECK(GetDoubleLE(&buffer[28]) == 1.0 && GetDoubleLE(&buffer[36]) == -2.5);
+
+    /// caller memory that fits exactly
+    uint8_t memory[32];
+    std::memset(memory, 0xee, sizeof(memory));
+    PackedWriter exact(buffer, memory, 24);
+    exact.putUInt32(7);
+    exact.putUInt32(0);
+    exact.putConfig(config);
+    CHECK(!exact.overflow());
+    CHECK(exact.size() == 24);
+    CHECK(GetUInt32LE(memory) == 7 && GetDoubleLE(memory + 16) == -2.5);
+    CHECK(memory[24] == 0xee);
+    CHECK(buffer.empty());
+
+    /// too small: nothing written past the capacity, not even a partial field,
+    /// and the size still counts what the whole response needs
+    std::memset(memory, 0xee, sizeof(memory));
+    PackedWriter small(buffer, memory, 10);
+    small.putUInt32(7);
+    small.putUInt32(8);
+    small.putUInt32(9);
+    small.putConfig(config);
+    CHECK(small.overflow());
+    CHECK(small.size() == 12 + 16);
+    CHECK(GetUInt32LE(memory) == 7 && GetUInt32LE(memory + 4) == 8);
+    for ( size_t i = 8; i < sizeof(memory); i++ )
+        CHECK(memory[i] == 0xee);
+}
+
+
+/// request as BinaryQuery parses it, through base64 like the text channel
+void testRequestRoundTrip()
+{
+    const uint32_t count = 3, dof = 4;
+    std::vector<uint8_t> request(12 + count*2*dof*8);
+    PutUInt32LE(&request[0], BINARY_CHANNEL_VERSION);
+    PutUInt32LE(&request[4], count);
+    PutUInt32LE(&request[8], dof);
+    for ( uint32_t i = 0; i < count*2*dof; i++ )
+        PutDoubleLE(&request[12 + 8*i], 0.25*i - 1);
+
+    std::string text;
+    Base64Encode(&request[0], request.size(), text);
+
+    std::vector<uint8_t> decoded;
+    CHECK(Base64Decode(text, decoded));
+    CHECK(decoded == request);
+    CHECK(GetUInt32LE(&decoded[4]) == count && GetUInt32LE(&decoded[8]) == dof);
+
+    const uint8_t* p = &decoded[12];
+    for ( uint32_t i = 0; i < count*2*dof; i++, p += 8 )
+        CHECK(GetDoubleLE(p) == 0.25*i - 1);
+}
+
+}
+
+
+int main()
+{
+    testByteOrder();
+    testBase64();
+    testPackedWriter();
+    testRequestRoundTrip();
+
+    if ( failures > 0 )
+        std::printf("%d checks failed\n", failures);
+    return failures > 0 ? 1 : 0;
+}